@@ -0,0 +1,168 @@
+#ifndef ATOMIC_SEGMENT_TREE
+#define ATOMIC_SEGMENT_TREE
+
+#include <vector>
+#include <atomic>
+#include <type_traits>
+
+namespace segment_tree_detail
+{
+    // Type sums of V are accumulated in: its unsigned counterpart for
+    // integers, where overflow wraps instead of being undefined
+    template < typename V, bool integral = std::is_integral<V>::value >
+    struct wrapping
+    {
+        typedef typename std::make_unsigned<V>::type type;
+    };
+
+    template < typename V >
+    struct wrapping< V, false >
+    {
+        typedef V type;
+    };
+
+    template < typename V >
+    V wrapping_add( V a, V b )
+    {
+        typedef typename wrapping<V>::type sum_type;
+        return (V)((sum_type)a + (sum_type)b);
+    }
+
+    template < typename V >
+    V wrapping_subtract( V a, V b )
+    {
+        typedef typename wrapping<V>::type sum_type;
+        return (V)((sum_type)a - (sum_type)b);
+    }
+
+    template < typename V >
+    V atomic_add( std::atomic<V>& x, V delta, std::true_type )
+    {
+        return x.fetch_add(delta, std::memory_order_relaxed);
+    }
+
+    // Floating point atomics have no fetch_add before C++20
+    template < typename V >
+    V atomic_add( std::atomic<V>& x, V delta, std::false_type )
+    {
+        V old = x.load(std::memory_order_relaxed);
+        while (!x.compare_exchange_weak(old, old + delta, std::memory_order_relaxed))
+        {
+        }
+        return old;
+    }
+
+    // Adds delta to x atomically and returns the previous value
+    template < typename V >
+    V atomic_add( std::atomic<V>& x, V delta )
+    {
+        return atomic_add(x, delta, std::is_integral<V>());
+    }
+}
+
+// Sum segment tree over arithmetic values that any number of threads may
+// update and query at once without locks. Nodes are atomics in the
+// layout of the iterative backend, and an update adds its delta to the
+// leaf and then to each ancestor with one atomic addition per node.
+//
+// All operations on the nodes are relaxed, so the only guarantees are
+// per-node atomicity and an eventually consistent total: no addition is
+// lost, and a query ordered after the updates, by joining their threads
+// or some other synchronization, is exact. A query running alongside
+// updates reads each node at its own moment and may count any subset of
+// them, a later one without an earlier one, so results are not
+// linearizable, and updates are not ordered with any other memory.
+// Integer sums wrap around; float sums may round differently from a
+// sequential order. Every update also adds to the root, which bounds
+// scaling on many cores.
+template < typename V >
+class atomic_segment_tree
+{
+    static_assert(std::is_arithmetic<V>::value, "atomic segment trees hold arithmetic values");
+
+public:
+    atomic_segment_tree( size_t N )
+        : ar_size(N)
+        , tree(2 * ar_size)
+    {
+        for (size_t p = 0; p < tree.size(); p++)
+        {
+            tree[p].store(V(0), std::memory_order_relaxed);
+        }
+    }
+
+    atomic_segment_tree( const std::vector<V>& init_ar )
+        : ar_size(init_ar.size())
+        , tree(2 * ar_size)
+    {
+        for (size_t i = 0; i < ar_size; i++)
+        {
+            tree[ar_size + i].store(init_ar[i], std::memory_order_relaxed);
+        }
+        for (size_t p = ar_size - 1; p > 0; p--)
+        {
+            tree[p].store(segment_tree_detail::wrapping_add(tree[2 * p].load(std::memory_order_relaxed), tree[2 * p + 1].load(std::memory_order_relaxed)),
+                          std::memory_order_relaxed);
+        }
+        tree[0].store(V(0), std::memory_order_relaxed);
+    }
+
+    size_t get_array_size()
+    {
+        return ar_size;
+    }
+
+    V range_query( int lo, int hi ) const
+    {
+        typedef typename segment_tree_detail::wrapping<V>::type sum_type;
+        sum_type solution = sum_type(0);
+        size_t l = ar_size + lo;
+        size_t r = ar_size + hi + 1;
+        for (; l < r; l >>= 1, r >>= 1)
+        {
+            if (l & 1)
+            {
+                solution += (sum_type)tree[l++].load(std::memory_order_relaxed);
+            }
+            if (r & 1)
+            {
+                solution += (sum_type)tree[--r].load(std::memory_order_relaxed);
+            }
+        }
+        return (V)solution;
+    }
+
+    // Adds delta to the element at index
+    void add( int index, V delta )
+    {
+        for (size_t p = ar_size + index; p > 0; p >>= 1)
+        {
+            segment_tree_detail::atomic_add(tree[p], delta);
+        }
+    }
+
+    // Replaces the element at index. Concurrent replacements of the same
+    // element take effect in some order, each passing on the difference
+    // from the value it replaced.
+    void point_update( int index, V new_value )
+    {
+        size_t p = ar_size + index;
+        V delta = segment_tree_detail::wrapping_subtract(new_value, tree[p].exchange(new_value, std::memory_order_relaxed));
+        for (p >>= 1; p > 0; p >>= 1)
+        {
+            segment_tree_detail::atomic_add(tree[p], delta);
+        }
+    }
+
+    // Bytes held by this instance for the nodes
+    size_t memory_footprint() const
+    {
+        return sizeof(*this) + tree.capacity() * sizeof(std::atomic<V>);
+    }
+
+private:
+    size_t ar_size;
+    std::vector<std::atomic<V>> tree;
+};
+
+#endif
@@ -0,0 +1,161 @@
+#ifndef CONCURRENT_SEGMENT_TREE
+#define CONCURRENT_SEGMENT_TREE
+
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <utility>
+#include <functional>
+
+// Wraps a tree type for any number of concurrent readers and writers,
+// with readers that never block, following the left-right technique.
+// Two instances of the tree are kept. Readers announce themselves on a
+// read indicator and query the instance the writers are not touching.
+// A writer applies its change to the other instance, switches readers
+// over, waits for the readers still on the old instance to leave, and
+// applies the same change there. Updates stay O(log N), twice over, and
+// any node type works since nothing is copied behind a reader's back.
+// Writers are serialized by a mutex.
+//
+// tree_type is basic_segment_tree or anything else whose queries do not
+// modify it; lazy_segment_tree pushes tags down while querying and does
+// not qualify. Memory is that of two trees, so trees without a copy of
+// the array, keep_array set to false, are the usual choice.
+template < typename tree_type >
+class concurrent_segment_tree
+{
+public:
+    // Both instances are built from the same arguments
+    template < typename... arguments >
+    explicit concurrent_segment_tree( const arguments&... args )
+        : left(args...)
+        , right(args...)
+        , reading_right(false)
+        , indicator(0)
+    {
+        for (size_t i = 0; i < 2 * stripes; i++)
+        {
+            counters[i].readers.store(0);
+        }
+    }
+
+    // Calls f with an instance that stays unchanged while f runs, and
+    // returns what f returns. f must only read, and may run alongside
+    // writers and other readers.
+    template < typename F >
+    auto read( F f ) -> decltype(f(std::declval<tree_type&>()))
+    {
+        size_t side = indicator.load();
+        read_counter& counter = counters[side * stripes + stripe()];
+        counter.readers.fetch_add(1);
+        departure leave(counter);
+        return f(reading_right.load() ? right : left);
+    }
+
+    template < typename index_type >
+    auto range_query( index_type lo, index_type hi ) -> decltype(std::declval<tree_type&>().range_query(lo, hi))
+    {
+        return read(
+            [&]( tree_type& tree )
+            {
+                return tree.range_query(lo, hi);
+            });
+    }
+
+    // Calls f on both instances in turn, so f must make the same change
+    // to each of them. Readers see the change all at once.
+    template < typename F >
+    void write( F f )
+    {
+        std::lock_guard<std::mutex> lock(writer);
+        bool was_right = reading_right.load();
+        f(was_right ? left : right);
+        reading_right.store(!was_right);
+
+        // Readers that may still be on the old instance registered on
+        // one indicator or the other, so both have to drain
+        size_t side = indicator.load();
+        wait_for_readers(1 - side);
+        indicator.store(1 - side);
+        wait_for_readers(side);
+
+        f(was_right ? right : left);
+    }
+
+    template < typename index_type, typename value_type >
+    void point_update( index_type index, const value_type& new_value )
+    {
+        write(
+            [&]( tree_type& tree )
+            {
+                tree.point_update(index, new_value);
+            });
+    }
+
+    template < typename update_list >
+    void point_update_batch( const update_list& updates, unsigned threads = 1 )
+    {
+        write(
+            [&]( tree_type& tree )
+            {
+                tree.point_update_batch(updates, threads);
+            });
+    }
+
+    size_t memory_footprint() const
+    {
+        return sizeof(*this) - sizeof(left) - sizeof(right) + left.memory_footprint() + right.memory_footprint();
+    }
+
+private:
+    // Readers spread over several counters per indicator, each on its own
+    // cache line, so that they do not all contend for one
+    static const size_t stripes = 16;
+
+    struct read_counter
+    {
+        std::atomic<size_t> readers;
+        char padding[64 - sizeof(std::atomic<size_t>)];
+    };
+
+    struct departure
+    {
+        read_counter& counter;
+
+        departure( read_counter& counter )
+            : counter(counter)
+        {
+        }
+
+        ~departure()
+        {
+            counter.readers.fetch_sub(1);
+        }
+    };
+
+    tree_type left;
+    tree_type right;
+    std::atomic<bool> reading_right;
+    std::atomic<size_t> indicator;
+    read_counter counters[2 * stripes];
+    std::mutex writer;
+
+    static size_t stripe()
+    {
+        static thread_local size_t s = std::hash<std::thread::id>()(std::this_thread::get_id()) % stripes;
+        return s;
+    }
+
+    void wait_for_readers( size_t side )
+    {
+        for (size_t i = 0; i < stripes; i++)
+        {
+            while (counters[side * stripes + i].readers.load() != 0)
+            {
+                std::this_thread::yield();
+            }
+        }
+    }
+};
+
+#endif
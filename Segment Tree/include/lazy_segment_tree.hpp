@@ -0,0 +1,453 @@
+#ifndef LAZY_SEGMENT_TREE
+#define LAZY_SEGMENT_TREE
+
+#include "segment_tree.hpp"
+
+#include <vector>
+#include <algorithm>
+#include <type_traits>
+#include <boost/optional.hpp>
+
+namespace segment_tree_detail
+{
+    template < typename lazy_policy, typename node, typename tag_type, typename = void >
+    struct has_can_apply : std::false_type
+    {
+    };
+
+    template < typename lazy_policy, typename node, typename tag_type >
+    struct has_can_apply< lazy_policy, node, tag_type, typename make_void<decltype(std::declval<const lazy_policy&>().can_apply(
+        std::declval<const node&>(), std::declval<const tag_type&>()))>::type > : std::true_type
+    {
+    };
+
+    template < typename lazy_policy, typename node, typename tag_type >
+    bool can_apply( const lazy_policy& policy, const node& x, const tag_type& tag, std::true_type )
+    {
+        return policy.can_apply(x, tag);
+    }
+
+    template < typename lazy_policy, typename node, typename tag_type >
+    bool can_apply( const lazy_policy&, const node&, const tag_type&, std::false_type )
+    {
+        return true;
+    }
+
+    // Policies without a can_apply member can summarize every tag at every node
+    template < typename lazy_policy, typename node, typename tag_type >
+    bool can_apply( const lazy_policy& policy, const node& x, const tag_type& tag )
+    {
+        return can_apply(policy, x, tag, has_can_apply<lazy_policy, node, tag_type>());
+    }
+}
+
+// A lazy policy is a merge policy that also provides
+//   typedef ... tag_type;
+//   void apply( node& x, const tag_type& tag, size_t length ) const;
+//   void compose( tag_type& existing, const tag_type& newer ) const;
+// apply updates the aggregate of a node covering length elements, and
+// compose folds a newer pending tag into an older one so that applying
+// the result equals applying existing and then newer. A policy may also
+// provide bool can_apply( const node& x, const tag_type& tag ) const;
+// range updates then descend past every internal node where it returns
+// false, which is how segment tree beats is built on this class.
+template <  typename        T,
+            typename        node,
+            typename        lazy_policy    >
+class lazy_segment_tree
+{
+public:
+    typedef typename lazy_policy::tag_type tag_type;
+
+    lazy_segment_tree( size_t N, const lazy_policy& policy = lazy_policy() )
+        : policy(policy)
+        , ar_size(N)
+        , tree(4 * ar_size + 2)
+        , tags(4 * ar_size + 2)
+        , has_tag(4 * ar_size + 2)
+    {
+    }
+
+    lazy_segment_tree( const std::vector<T>& init_ar, const lazy_policy& policy = lazy_policy() )
+        : policy(policy)
+        , ar_size(init_ar.size())
+        , tree(4 * ar_size + 2)
+        , tags(4 * ar_size + 2)
+        , has_tag(4 * ar_size + 2)
+    {
+        construct_tree(1, 0, (int)ar_size - 1, init_ar);
+    }
+
+    void construct_tree( const std::vector<T>& init_ar )
+    {
+        std::fill(has_tag.begin(), has_tag.end(), 0);
+        construct_tree(1, 0, (int)ar_size - 1, init_ar);
+    }
+
+    size_t get_array_size()
+    {
+        return ar_size;
+    }
+
+    node range_query( int lo, int hi )
+    {
+        return range_query(lo, hi, segment_tree_detail::has_identity<node>());
+    }
+
+    void point_update( int index, T new_value )
+    {
+        update_tree_over_point(1, 0, (int)ar_size - 1, index, new_value);
+    }
+
+    void range_update( int lo, int hi, const tag_type& tag )
+    {
+        update_tree_over_range(1, 0, (int)ar_size - 1, lo, hi, tag);
+    }
+
+    // Bytes held by this instance for the node and pending tag storage
+    size_t memory_footprint() const
+    {
+        return sizeof(*this) + tree.capacity() * sizeof(node)
+                             + tags.capacity() * sizeof(tag_type)
+                             + has_tag.capacity() * sizeof(char);
+    }
+
+private:
+    lazy_policy policy;
+    size_t ar_size;
+    std::vector<node> tree;
+    std::vector<tag_type> tags;
+    std::vector<char> has_tag;
+
+    void construct_tree( int node_index, int node_lo, int node_hi, const std::vector<T>& ar )
+    {
+        if (node_lo == node_hi)
+        {
+            policy.set_default_value(tree[node_index], ar[node_lo]);
+        }
+        else
+        {
+            int mid = node_lo + (node_hi - node_lo) / 2;
+            construct_tree(2 * node_index, node_lo, mid, ar);
+            construct_tree(2 * node_index + 1, mid + 1, node_hi, ar);
+            segment_tree_detail::merge_into(policy, tree[node_index], tree[2 * node_index], tree[2 * node_index + 1]);
+        }
+    }
+
+    // Applies tag to the aggregate of a node and, unless the node is
+    // a leaf, remembers it for the children
+    void apply_tag( int node_index, int node_lo, int node_hi, const tag_type& tag )
+    {
+        policy.apply(tree[node_index], tag, (size_t)(node_hi - node_lo + 1));
+        if (node_lo != node_hi)
+        {
+            if (has_tag[node_index])
+            {
+                policy.compose(tags[node_index], tag);
+            }
+            else
+            {
+                tags[node_index] = tag;
+                has_tag[node_index] = 1;
+            }
+        }
+    }
+
+    void push_down( int node_index, int node_lo, int mid, int node_hi )
+    {
+        if (has_tag[node_index])
+        {
+            apply_tag(2 * node_index, node_lo, mid, tags[node_index]);
+            apply_tag(2 * node_index + 1, mid + 1, node_hi, tags[node_index]);
+            has_tag[node_index] = 0;
+        }
+    }
+
+    void pull_up( int node_index )
+    {
+        segment_tree_detail::merge_into(policy, tree[node_index], tree[2 * node_index], tree[2 * node_index + 1]);
+    }
+
+    node range_query( int lo, int hi, std::true_type )
+    {
+        node solution = segment_tree_identity<node>::value();
+        node scratch = solution;
+        range_query(1, 0, (int)ar_size - 1, lo, hi, solution, scratch);
+        return solution;
+    }
+
+    node range_query( int lo, int hi, std::false_type )
+    {
+        return *range_query(1, 0, (int)ar_size - 1, lo, hi);
+    }
+
+    // Folds the fully contained nodes into solution from left to right
+    void range_query( int node_index, int node_lo, int node_hi, int lo, int hi, node& solution, node& scratch )
+    {
+        // Interval doesn't intersect at all
+        if (lo > node_hi || hi < node_lo)
+        {
+            return;
+        }
+
+        // Interval completely contained
+        if (lo <= node_lo && hi >= node_hi)
+        {
+            segment_tree_detail::merge_into(policy, scratch, solution, tree[node_index]);
+            std::swap(solution, scratch);
+            return;
+        }
+
+        // Interval partially intersects
+        int mid = node_lo + (node_hi - node_lo) / 2;
+        push_down(node_index, node_lo, mid, node_hi);
+        range_query(2 * node_index, node_lo, mid, lo, hi, solution, scratch);
+        range_query(2 * node_index + 1, mid + 1, node_hi, lo, hi, solution, scratch);
+    }
+
+    boost::optional<node> range_query( int node_index, int node_lo, int node_hi, int lo, int hi )
+    {
+        // Interval doesn't intersect at all
+        if (lo > node_hi || hi < node_lo)
+        {
+            return boost::none;
+        }
+
+        // Interval completely contained
+        if (lo <= node_lo && hi >= node_hi)
+        {
+            return tree[node_index];
+        }
+
+        // Interval partially intersects
+        int mid = node_lo + (node_hi - node_lo) / 2;
+        push_down(node_index, node_lo, mid, node_hi);
+        boost::optional<node> left_solution = range_query(2 * node_index, node_lo, mid, lo, hi);
+        boost::optional<node> right_solution = range_query(2 * node_index + 1, mid + 1, node_hi, lo, hi);
+        if (!right_solution && !left_solution)
+        {
+            return boost::none;
+        }
+        if (!left_solution && right_solution)
+        {
+            return right_solution;
+        }
+        if (!right_solution && left_solution)
+        {
+            return left_solution;
+        }
+        node solution;
+        segment_tree_detail::merge_into(policy, solution, *left_solution, *right_solution);
+        return solution;
+    }
+
+    void update_tree_over_point( int node_index, int node_lo, int node_hi, int index, const T& value )
+    {
+        // Interval has converged to index
+        if (node_lo == node_hi)
+        {
+            policy.set_default_value(tree[node_index], value);
+            return;
+        }
+
+        // Only the child containing index needs to be revisited
+        int mid = node_lo + (node_hi - node_lo) / 2;
+        push_down(node_index, node_lo, mid, node_hi);
+        if (index <= mid)
+        {
+            update_tree_over_point(2 * node_index, node_lo, mid, index, value);
+        }
+        else
+        {
+            update_tree_over_point(2 * node_index + 1, mid + 1, node_hi, index, value);
+        }
+        pull_up(node_index);
+    }
+
+    void update_tree_over_range( int node_index, int node_lo, int node_hi, int lo, int hi, const tag_type& tag )
+    {
+        // Interval doesn't intersect at all
+        if (lo > node_hi || hi < node_lo)
+        {
+            return;
+        }
+
+        // Interval completely contained, the children are updated lazily
+        if (lo <= node_lo && hi >= node_hi &&
+            (node_lo == node_hi || segment_tree_detail::can_apply(policy, tree[node_index], tag)))
+        {
+            apply_tag(node_index, node_lo, node_hi, tag);
+            return;
+        }
+
+        // Interval partially intersects
+        int mid = node_lo + (node_hi - node_lo) / 2;
+        push_down(node_index, node_lo, mid, node_hi);
+        update_tree_over_range(2 * node_index, node_lo, mid, lo, hi, tag);
+        update_tree_over_range(2 * node_index + 1, mid + 1, node_hi, lo, hi, tag);
+        pull_up(node_index);
+    }
+};
+
+
+// Aggregate maintained by the ready-made lazy policies
+template < typename V >
+struct range_aggregate
+{
+    V sum;
+    V min;
+    V max;
+};
+
+template < typename V >
+struct range_aggregate_policy
+{
+    void set_default_value( range_aggregate<V>& x, const V& y ) const
+    {
+        x.sum = y;
+        x.min = y;
+        x.max = y;
+    }
+
+    void merge( range_aggregate<V>& out, const range_aggregate<V>& a, const range_aggregate<V>& b ) const
+    {
+        out.sum = a.sum + b.sum;
+        out.min = std::min(a.min, b.min);
+        out.max = std::max(a.max, b.max);
+    }
+};
+
+// Adds a delta to every element of a range
+template < typename V >
+struct range_add_policy : range_aggregate_policy<V>
+{
+    typedef V tag_type;
+
+    void apply( range_aggregate<V>& x, const V& delta, size_t length ) const
+    {
+        x.sum += delta * (V)length;
+        x.min += delta;
+        x.max += delta;
+    }
+
+    void compose( V& existing, const V& newer ) const
+    {
+        existing += newer;
+    }
+};
+
+// Assigns a value to every element of a range
+template < typename V >
+struct range_assign_policy : range_aggregate_policy<V>
+{
+    typedef V tag_type;
+
+    void apply( range_aggregate<V>& x, const V& value, size_t length ) const
+    {
+        x.sum = value * (V)length;
+        x.min = value;
+        x.max = value;
+    }
+
+    void compose( V& existing, const V& newer ) const
+    {
+        existing = newer;
+    }
+};
+
+// Maps every element x of a range to mul * x + add
+template < typename V >
+struct affine_map
+{
+    V mul;
+    V add;
+};
+
+// Applies affine maps to ranges, keeping sum, min and max
+template < typename V >
+struct range_affine_policy : range_aggregate_policy<V>
+{
+    typedef affine_map<V> tag_type;
+
+    void apply( range_aggregate<V>& x, const tag_type& f, size_t length ) const
+    {
+        x.sum = f.mul * x.sum + f.add * (V)length;
+        V low = f.mul * x.min + f.add;
+        V high = f.mul * x.max + f.add;
+        // A negative factor swaps the extremes
+        x.min = std::min(low, high);
+        x.max = std::max(low, high);
+    }
+
+    void compose( tag_type& existing, const tag_type& newer ) const
+    {
+        existing.add = newer.mul * existing.add + newer.add;
+        existing.mul = newer.mul * existing.mul;
+    }
+};
+
+// Aggregate maintained by modular_range_affine_policy
+template < typename V >
+struct modular_range_sum
+{
+    V sum;
+};
+
+// Applies affine maps to ranges and keeps range sums modulo a runtime
+// modulus. (modulus - 1) * (modulus - 1) must be representable in V.
+template < typename V >
+struct modular_range_affine_policy
+{
+    typedef affine_map<V> tag_type;
+
+    V modulus;
+
+    modular_range_affine_policy( V modulus )
+        : modulus(modulus)
+    {
+    }
+
+    V reduce( V x ) const
+    {
+        return reduce(x, std::is_signed<V>());
+    }
+
+    // Only a signed remainder can come out negative
+    V reduce( V x, std::true_type ) const
+    {
+        x %= modulus;
+        return x < 0 ? x + modulus : x;
+    }
+
+    V reduce( V x, std::false_type ) const
+    {
+        return x % modulus;
+    }
+
+    void set_default_value( modular_range_sum<V>& x, const V& y ) const
+    {
+        x.sum = reduce(y);
+    }
+
+    void merge( modular_range_sum<V>& out, const modular_range_sum<V>& a, const modular_range_sum<V>& b ) const
+    {
+        out.sum = (a.sum + b.sum) % modulus;
+    }
+
+    // Tags are reduced as they are used, so that callers may pass negative
+    // coefficients or ones past the modulus
+    void apply( modular_range_sum<V>& x, const tag_type& f, size_t length ) const
+    {
+        V add = reduce(f.add) * reduce((V)length) % modulus;
+        x.sum = (reduce(f.mul) * x.sum % modulus + add) % modulus;
+    }
+
+    void compose( tag_type& existing, const tag_type& newer ) const
+    {
+        V mul = reduce(newer.mul);
+        existing.add = (mul * reduce(existing.add) % modulus + reduce(newer.add)) % modulus;
+        existing.mul = mul * reduce(existing.mul) % modulus;
+    }
+};
+
+#endif
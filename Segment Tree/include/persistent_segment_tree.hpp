@@ -0,0 +1,253 @@
+#ifndef PERSISTENT_SEGMENT_TREE
+#define PERSISTENT_SEGMENT_TREE
+
+#include "segment_tree.hpp"
+#include "segment_tree_pool.hpp"
+
+#include <vector>
+#include <utility>
+#include <stdexcept>
+
+// Segment tree keeping every version of the array. A point update copies
+// the log N nodes on the path to the updated leaf and shares the rest with
+// the version it started from, so a version costs O(log N) nodes. Versions
+// are numbered from 0, the initial array, in the order they are created,
+// and any live version can be queried or updated again. Nodes are counted
+// by their owners, a parent or a version, and go back to the pool when the
+// last version reaching them is released. Querying or updating a version
+// that is not live throws std::out_of_range. Takes the same node types and
+// merge policies as basic_segment_tree.
+template <  typename        T,
+            typename        node,
+            typename        merge_policy    >
+class basic_persistent_segment_tree
+{
+public:
+    basic_persistent_segment_tree( size_t N, const merge_policy& policy = merge_policy() )
+        : policy(policy)
+    {
+        construct_tree(std::vector<T>(N));
+    }
+
+    basic_persistent_segment_tree( const std::vector<T>& init_ar, const merge_policy& policy = merge_policy() )
+        : policy(policy)
+    {
+        construct_tree(init_ar);
+    }
+
+    // Drops every version and starts over with init_ar as version 0
+    void construct_tree( const std::vector<T>& init_ar )
+    {
+        ar_size = init_ar.size();
+        pool.clear();
+        roots.assign(1, construct_tree(0, (int)ar_size - 1, init_ar));
+        live_versions = 1;
+    }
+
+    size_t get_array_size()
+    {
+        return ar_size;
+    }
+
+    node range_query( size_t version, int lo, int hi )
+    {
+        check_live(version);
+        node solution = node();
+        node scratch = node();
+        bool started = false;
+        range_query(roots[version], 0, (int)ar_size - 1, lo, hi, solution, scratch, started);
+        return solution;
+    }
+
+    // Returns the number of the new version, which is version with the
+    // element at index replaced
+    size_t point_update( size_t version, int index, const T& new_value )
+    {
+        check_live(version);
+        roots.push_back(update_tree_over_point(roots[version], 0, (int)ar_size - 1, index, new_value));
+        live_versions++;
+        return roots.size() - 1;
+    }
+
+    // The version can no longer be used, and nodes no other live version
+    // reaches are returned to the pool. Numbers are not reused. Releasing
+    // a version that is not live does nothing.
+    void release_version( size_t version )
+    {
+        if (!is_live(version))
+        {
+            return;
+        }
+        release(roots[version]);
+        roots[version] = pool_type::null;
+        live_versions--;
+    }
+
+    bool is_live( size_t version ) const
+    {
+        return version < roots.size() && roots[version] != pool_type::null;
+    }
+
+    // Number of the most recently created version
+    size_t latest_version() const
+    {
+        return roots.size() - 1;
+    }
+
+    size_t live_version_count() const
+    {
+        return live_versions;
+    }
+
+    size_t live_node_count() const
+    {
+        return pool.live_entries();
+    }
+
+    // Bytes held by this instance for the node pool and the version roots,
+    // not counting memory owned by the nodes themselves
+    size_t memory_footprint() const
+    {
+        return sizeof(*this) + pool.memory_footprint() + roots.capacity() * sizeof(handle);
+    }
+
+private:
+    struct entry
+    {
+        node value;
+        std::uint32_t left;
+        std::uint32_t right;
+        std::uint32_t owners;
+    };
+
+    typedef segment_tree_detail::node_pool<entry> pool_type;
+    typedef typename pool_type::handle handle;
+
+    merge_policy policy;
+    size_t ar_size;
+    size_t live_versions;
+    pool_type pool;
+    std::vector<handle> roots;
+
+    // A released root is the null handle, and walking it would read and
+    // count owners on the pool's null entry
+    void check_live( size_t version ) const
+    {
+        if (!is_live(version))
+        {
+            throw std::out_of_range("persistent_segment_tree: version is not live");
+        }
+    }
+
+    // New node with a single owner and the given children
+    handle make_node( handle left, handle right )
+    {
+        handle v = pool.allocate();
+        entry& e = pool[v];
+        e.left = left;
+        e.right = right;
+        e.owners = 1;
+        if (left != pool_type::null)
+        {
+            segment_tree_detail::merge_into(policy, e.value, pool[left].value, pool[right].value);
+        }
+        return v;
+    }
+
+    handle construct_tree( int node_lo, int node_hi, const std::vector<T>& ar )
+    {
+        if (node_lo == node_hi)
+        {
+            handle v = make_node(pool_type::null, pool_type::null);
+            policy.set_default_value(pool[v].value, ar[node_lo]);
+            return v;
+        }
+        int mid = node_lo + (node_hi - node_lo) / 2;
+        handle left = construct_tree(node_lo, mid, ar);
+        handle right = construct_tree(mid + 1, node_hi, ar);
+        return make_node(left, right);
+    }
+
+    // Folds the fully contained nodes into solution from left to right
+    void range_query( handle v, int node_lo, int node_hi, int lo, int hi, node& solution, node& scratch, bool& started )
+    {
+        // Interval doesn't intersect at all
+        if (lo > node_hi || hi < node_lo)
+        {
+            return;
+        }
+
+        // Interval completely contained
+        if (lo <= node_lo && hi >= node_hi)
+        {
+            if (!started)
+            {
+                solution = pool[v].value;
+                started = true;
+                return;
+            }
+            segment_tree_detail::merge_into(policy, scratch, solution, pool[v].value);
+            std::swap(solution, scratch);
+            return;
+        }
+
+        // Interval partially intersects
+        int mid = node_lo + (node_hi - node_lo) / 2;
+        range_query(pool[v].left, node_lo, mid, lo, hi, solution, scratch, started);
+        range_query(pool[v].right, mid + 1, node_hi, lo, hi, solution, scratch, started);
+    }
+
+    // Copies the path from v to the leaf at index, the sibling of every
+    // copied node gaining the copy as an owner
+    handle update_tree_over_point( handle v, int node_lo, int node_hi, int index, const T& value )
+    {
+        // Interval has converged to index
+        if (node_lo == node_hi)
+        {
+            handle leaf = make_node(pool_type::null, pool_type::null);
+            policy.set_default_value(pool[leaf].value, value);
+            return leaf;
+        }
+
+        int mid = node_lo + (node_hi - node_lo) / 2;
+        handle left = pool[v].left;
+        handle right = pool[v].right;
+        if (index <= mid)
+        {
+            left = update_tree_over_point(left, node_lo, mid, index, value);
+            pool[right].owners++;
+        }
+        else
+        {
+            right = update_tree_over_point(right, mid + 1, node_hi, index, value);
+            pool[left].owners++;
+        }
+        return make_node(left, right);
+    }
+
+    // Drops one owner of v, releasing it and then its children once none is left
+    void release( handle v )
+    {
+        entry& e = pool[v];
+        if (--e.owners != 0)
+        {
+            return;
+        }
+        handle left = e.left;
+        handle right = e.right;
+        pool.release(v);
+        if (left != pool_type::null)
+        {
+            release(left);
+            release(right);
+        }
+    }
+};
+
+template <  typename        T,
+            typename        node,
+            void            (*set_default_value)(node&, T),
+            node           (*merge)(node*, node*)    >
+using persistent_segment_tree = basic_persistent_segment_tree< T, node, function_merge_policy<T, node, set_default_value, merge> >;
+
+#endif
@@ -1,156 +1,1204 @@
 #ifndef SEGMENT_TREE
 #define SEGMENT_TREE
 
+#include "segment_tree_parallel.hpp"
+
 #include <vector>
+#include <utility>
+#include <iterator>
+#include <algorithm>
+#include <type_traits>
 #include <boost/optional.hpp>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// Specialize for a node type with a static value() returning the identity
+// of its merge. Queries then fold straight into an accumulator; without a
+// specialization they fall back to boost::optional partial results.
+template < typename node >
+struct segment_tree_identity
+{
+};
+
+namespace segment_tree_detail
+{
+    template < typename... >
+    struct make_void
+    {
+        typedef void type;
+    };
+
+    template < typename node, typename = void >
+    struct has_identity : std::false_type
+    {
+    };
+
+    template < typename node >
+    struct has_identity< node, typename make_void<decltype(segment_tree_identity<node>::value())>::type > : std::true_type
+    {
+    };
+
+    template < typename merge_policy, typename node, typename = void >
+    struct has_inplace_merge : std::false_type
+    {
+    };
+
+    template < typename merge_policy, typename node >
+    struct has_inplace_merge< merge_policy, node, typename make_void<decltype(std::declval<const merge_policy&>().merge(
+        std::declval<node&>(), std::declval<const node&>(), std::declval<const node&>()))>::type > : std::true_type
+    {
+    };
+
+    template < typename merge_policy, typename node >
+    void merge_into( const merge_policy& policy, node& out, node& a, node& b, std::true_type )
+    {
+        policy.merge(out, a, b);
+    }
+
+    template < typename merge_policy, typename node >
+    void merge_into( const merge_policy& policy, node& out, node& a, node& b, std::false_type )
+    {
+        out = policy.merge(&a, &b);
+    }
+
+    // Smallest amount of work handed to a thread of its own
+    const size_t parallel_grain = 1 << 12;
+
+    // Queries claimed at a time by a thread answering a batch of them
+    const size_t query_grain = 1 << 8;
+
+    // Queries a thread keeps in flight at once when it interleaves them
+    const size_t query_lanes = 16;
+
+    // Node storage from which interleaving queries pays off. Smaller trees
+    // mostly hit the caches, and the bookkeeping costs more than the
+    // overlapped misses save.
+    const size_t interleave_bytes = (size_t)1 << 26;
+
+    // Writes the merge of a and b into out, which must not alias either of them.
+    // Policies with a void merge(node& out, const node& a, const node& b) member
+    // reuse the storage already held by out instead of returning a new node.
+    template < typename merge_policy, typename node >
+    void merge_into( const merge_policy& policy, node& out, node& a, node& b )
+    {
+        merge_into(policy, out, a, b, has_inplace_merge<merge_policy, node>());
+    }
+
+    // Position of the highest set bit, x must not be zero
+    inline size_t floor_log2( size_t x )
+    {
+#if defined(_MSC_VER) && defined(_WIN64)
+        unsigned long index;
+        _BitScanReverse64(&index, x);
+        return index;
+#elif defined(_MSC_VER)
+        unsigned long index;
+        _BitScanReverse(&index, (unsigned long)x);
+        return index;
+#else
+        return sizeof(unsigned long long) * 8 - 1 - __builtin_clzll(x);
+#endif
+    }
+
+    // Hints the processor to start loading address into the cache
+    inline void prefetch( const void* address )
+    {
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+        _mm_prefetch((const char*)address, _MM_HINT_T0);
+#elif defined(__GNUC__)
+        __builtin_prefetch(address);
+#else
+        (void)address;
+#endif
+    }
+
+    // Heap order over a 4N + 2 node array with the root at index 1 and
+    // the children of node v at 2v and 2v + 1
+    class heap_layout
+    {
+    public:
+        heap_layout( size_t N )
+            : slots(4 * N + 2)
+        {
+        }
+
+        size_t size() const
+        {
+            return slots;
+        }
+
+        size_t memory_footprint() const
+        {
+            return 0;
+        }
+
+        static size_t root()
+        {
+            return 1;
+        }
+
+        static size_t left( size_t v, size_t )
+        {
+            return 2 * v;
+        }
+
+        static size_t right( size_t v, size_t )
+        {
+            return 2 * v + 1;
+        }
+
+        static size_t slot( size_t v )
+        {
+            return v;
+        }
+
+    private:
+        size_t slots;
+    };
+
+    // Preorder over exactly 2N - 1 nodes. The left child of a node directly
+    // follows it and the right child follows the whole left subtree, which
+    // holds 2 * left_size - 1 nodes for left_size elements. A descent moves
+    // forward through the array and the top of the tree sits at its start.
+    class preorder_layout
+    {
+    public:
+        preorder_layout( size_t N )
+            : slots(N == 0 ? 0 : 2 * N - 1)
+        {
+        }
+
+        size_t size() const
+        {
+            return slots;
+        }
+
+        size_t memory_footprint() const
+        {
+            return 0;
+        }
+
+        static size_t root()
+        {
+            return 0;
+        }
+
+        static size_t left( size_t v, size_t )
+        {
+            return v + 1;
+        }
+
+        static size_t right( size_t v, size_t left_size )
+        {
+            return v + 2 * left_size;
+        }
+
+        static size_t slot( size_t v )
+        {
+            return v;
+        }
+
+    private:
+        size_t slots;
+    };
+
+    // Top-down engine over nodes placed by a layout. The root covers the
+    // whole array and every node splits its interval at the midpoint. Node
+    // bounds are not stored, they are derived while descending. A layout
+    // provides size(), root(), left(v, left_size), right(v, left_size) and
+    // slot(v), the index of node v in the node array, left_size being the
+    // number of elements under the left child of v.
+    template <  typename        T,
+                typename        node,
+                typename        merge_policy,
+                typename        layout,
+                typename        index_type    >
+    class top_down_engine
+    {
+    public:
+        top_down_engine( size_t N, const merge_policy& policy )
+            : policy(policy)
+            , ar_size(N)
+            , nodes(N)
+            , tree(nodes.size())
+        {
+        }
+
+        template < typename source >
+        void construct_tree( const source& ar, unsigned threads )
+        {
+            construct_tree(nodes.root(), 0, (index_type)ar_size - 1, ar, threads);
+        }
+
+        node range_query( index_type lo, index_type hi )
+        {
+            return range_query(lo, hi, has_identity<node>());
+        }
+
+        template < typename value_type >
+        void point_update( index_type index, value_type&& value )
+        {
+            update_tree_over_point(nodes.root(), 0, (index_type)ar_size - 1, index, std::forward<value_type>(value));
+        }
+
+        // indices must be sorted and free of duplicates
+        template < typename source >
+        void point_update_batch( const std::vector<index_type>& indices, const source& ar, unsigned threads )
+        {
+            if (!indices.empty())
+            {
+                update_tree_over_points(nodes.root(), 0, (index_type)ar_size - 1, &indices[0], &indices[0] + indices.size(), ar, threads);
+            }
+        }
+
+        size_t memory_footprint() const
+        {
+            return sizeof(*this) + nodes.memory_footprint() + tree.capacity() * sizeof(node);
+        }
+
+    private:
+        merge_policy policy;
+        size_t ar_size;
+        layout nodes;
+        std::vector<node> tree;
+
+        node& at( size_t v )
+        {
+            return tree[nodes.slot(v)];
+        }
+
+        void pull_up( size_t v, size_t left, size_t right )
+        {
+            merge_into(policy, at(v), at(left), at(right));
+        }
+
+        template < typename source >
+        void construct_tree( size_t v, index_type node_lo, index_type node_hi, const source& ar, unsigned threads )
+        {
+            if (node_lo == node_hi)
+            {
+                policy.set_default_value(at(v), ar[node_lo]);
+            }
+            else
+            {
+                index_type mid = node_lo + (node_hi - node_lo) / 2;
+                size_t left_size = (size_t)(mid - node_lo) + 1;
+                size_t left = nodes.left(v, left_size);
+                size_t right = nodes.right(v, left_size);
+                auto construct_left = [&]()
+                {
+                    construct_tree(left, node_lo, mid, ar, threads / 2);
+                };
+                auto construct_right = [&]()
+                {
+                    construct_tree(right, mid + 1, node_hi, ar, threads - threads / 2);
+                };
+                if (threads > 1 && (size_t)(node_hi - node_lo) >= parallel_grain)
+                {
+                    parallel_invoke(construct_left, construct_right);
+                }
+                else
+                {
+                    construct_left();
+                    construct_right();
+                }
+                pull_up(v, left, right);
+            }
+        }
+
+        node range_query( index_type lo, index_type hi, std::true_type )
+        {
+            node solution = segment_tree_identity<node>::value();
+            node scratch = solution;
+            range_query(nodes.root(), 0, (index_type)ar_size - 1, lo, hi, solution, scratch);
+            return solution;
+        }
+
+        node range_query( index_type lo, index_type hi, std::false_type )
+        {
+            return *range_query(nodes.root(), 0, (index_type)ar_size - 1, lo, hi);
+        }
+
+        // Folds the fully contained nodes into solution from left to right
+        void range_query( size_t v, index_type node_lo, index_type node_hi, index_type lo, index_type hi, node& solution, node& scratch )
+        {
+            // Interval doesn't intersect at all
+            if (lo > node_hi || hi < node_lo)
+            {
+                return;
+            }
+
+            // Interval completely contained
+            if (lo <= node_lo && hi >= node_hi)
+            {
+                merge_into(policy, scratch, solution, at(v));
+                std::swap(solution, scratch);
+                return;
+            }
+
+            // Interval partially intersects. The right child is fetched
+            // while the left subtree is being searched.
+            index_type mid = node_lo + (node_hi - node_lo) / 2;
+            size_t left_size = (size_t)(mid - node_lo) + 1;
+            size_t right = nodes.right(v, left_size);
+            prefetch(&at(right));
+            range_query(nodes.left(v, left_size), node_lo, mid, lo, hi, solution, scratch);
+            range_query(right, mid + 1, node_hi, lo, hi, solution, scratch);
+        }
+
+        boost::optional<node> range_query( size_t v, index_type node_lo, index_type node_hi, index_type lo, index_type hi )
+        {
+            // Interval doesn't intersect at all
+            if (lo > node_hi || hi < node_lo)
+            {
+                return boost::none;
+            }
+
+            // Interval completely contained
+            if (lo <= node_lo && hi >= node_hi)
+            {
+                return at(v);
+            }
+
+            // Interval partially intersects
+            index_type mid = node_lo + (node_hi - node_lo) / 2;
+            size_t left_size = (size_t)(mid - node_lo) + 1;
+            size_t right = nodes.right(v, left_size);
+            prefetch(&at(right));
+            boost::optional<node> left_solution = range_query(nodes.left(v, left_size), node_lo, mid, lo, hi);
+            boost::optional<node> right_solution = range_query(right, mid + 1, node_hi, lo, hi);
+            if (!right_solution && !left_solution)
+            {
+                return boost::none;
+            }
+            if (!left_solution && right_solution)
+            {
+                return *right_solution;
+            }
+            if (!right_solution && left_solution)
+            {
+                return *left_solution;
+            }
+            node solution;
+            merge_into(policy, solution, *left_solution, *right_solution);
+            return solution;
+        }
+
+        // Only the one path taken reaches a leaf, so value is forwarded once
+        template < typename value_type >
+        void update_tree_over_point( size_t v, index_type node_lo, index_type node_hi, index_type index, value_type&& value )
+        {
+            // Interval has converged to index
+            if (node_lo == node_hi)
+            {
+                policy.set_default_value(at(v), std::forward<value_type>(value));
+                return;
+            }
+
+            // Only the child containing index needs to be revisited, its
+            // sibling is fetched for the merge on the way back up
+            index_type mid = node_lo + (node_hi - node_lo) / 2;
+            size_t left_size = (size_t)(mid - node_lo) + 1;
+            size_t left = nodes.left(v, left_size);
+            size_t right = nodes.right(v, left_size);
+            if (index <= mid)
+            {
+                prefetch(&at(right));
+                update_tree_over_point(left, node_lo, mid, index, std::forward<value_type>(value));
+            }
+            else
+            {
+                prefetch(&at(left));
+                update_tree_over_point(right, mid + 1, node_hi, index, std::forward<value_type>(value));
+            }
+            pull_up(v, left, right);
+        }
+
+        // Visits every node containing one of the sorted indices in [first, last) once
+        template < typename source >
+        void update_tree_over_points( size_t v, index_type node_lo, index_type node_hi, const index_type* first, const index_type* last,
+                                      const source& ar, unsigned threads )
+        {
+            // Interval has converged to an index
+            if (node_lo == node_hi)
+            {
+                policy.set_default_value(at(v), ar[node_lo]);
+                return;
+            }
+
+            // Split the indices between the children
+            index_type mid = node_lo + (node_hi - node_lo) / 2;
+            size_t left_size = (size_t)(mid - node_lo) + 1;
+            const index_type* split = std::upper_bound(first, last, mid);
+            size_t left = nodes.left(v, left_size);
+            size_t right = nodes.right(v, left_size);
+            auto update_left = [&]()
+            {
+                if (first != split)
+                {
+                    update_tree_over_points(left, node_lo, mid, first, split, ar, threads / 2);
+                }
+            };
+            auto update_right = [&]()
+            {
+                if (split != last)
+                {
+                    update_tree_over_points(right, mid + 1, node_hi, split, last, ar, threads - threads / 2);
+                }
+            };
+            if (threads > 1 && first != split && split != last && (size_t)(last - first) >= parallel_grain)
+            {
+                parallel_invoke(update_left, update_right);
+            }
+            else
+            {
+                update_left();
+                update_right();
+            }
+            pull_up(v, left, right);
+        }
+    };
+}
 
+namespace segment_tree_backend
+{
+    // Non-recursive engine over a 2N node array. Leaf i lives at N + i and
+    // every internal node p aggregates nodes 2p and 2p + 1, so point updates
+    // walk leaf-to-root and range queries walk two pointers towards each other.
+    struct iterative
+    {
+        template <  typename        T,
+                    typename        node,
+                    typename        merge_policy,
+                    typename        index_type    >
+        class engine
+        {
+        public:
+            engine( size_t N, const merge_policy& policy )
+                : policy(policy)
+                , ar_size(N)
+                , tree(2 * ar_size)
+            {
+            }
+
+            template < typename source >
+            void construct_tree( const source& ar, unsigned threads )
+            {
+                size_t deepest;
+                size_t depth;
+                leaf_levels(deepest, depth);
+                size_t level = subtree_level(threads, depth);
+                if (threads <= 1 || ar_size < 2 * segment_tree_detail::parallel_grain || level == 0)
+                {
+                    for (size_t i = 0; i < ar_size; i++)
+                    {
+                        policy.set_default_value(tree[ar_size + i], ar[i]);
+                    }
+                    for (size_t p = ar_size - 1; p > 0; p--)
+                    {
+                        segment_tree_detail::merge_into(policy, tree[p], tree[2 * p], tree[2 * p + 1]);
+                    }
+                    return;
+                }
+
+                // Build the subtrees below level concurrently, then the levels above
+                size_t roots = (size_t)1 << level;
+                segment_tree_detail::parallel_for(roots, 2 * roots, threads, 1,
+                    [&]( size_t first, size_t last )
+                    {
+                        construct_subtrees(first, last, ar);
+                    });
+                for (size_t p = roots - 1; p > 0; p--)
+                {
+                    segment_tree_detail::merge_into(policy, tree[p], tree[2 * p], tree[2 * p + 1]);
+                }
+            }
+
+            node range_query( index_type lo, index_type hi )
+            {
+                return range_query(lo, hi, segment_tree_detail::has_identity<node>());
+            }
+
+            template < typename value_type >
+            void point_update( index_type index, value_type&& value )
+            {
+                size_t p = ar_size + index;
+                policy.set_default_value(tree[p], std::forward<value_type>(value));
+                for (p >>= 1; p > 0; p >>= 1)
+                {
+                    segment_tree_detail::merge_into(policy, tree[p], tree[2 * p], tree[2 * p + 1]);
+                }
+            }
+
+            // indices must be sorted and free of duplicates
+            template < typename source >
+            void point_update_batch( const std::vector<index_type>& indices, const source& ar, unsigned threads )
+            {
+                if (indices.empty())
+                {
+                    return;
+                }
+
+                // The deeper level of leaves holds the leftmost part of the tree,
+                // so it comes first in tree order
+                size_t deepest;
+                size_t depth;
+                leaf_levels(deepest, depth);
+                std::vector<tree_position> leaves;
+                leaves.reserve(indices.size());
+                size_t split = std::lower_bound(indices.begin(), indices.end(), (index_type)(deepest - ar_size)) - indices.begin();
+                for (size_t i = split; i < indices.size(); i++)
+                {
+                    tree_position leaf = { ar_size + indices[i], depth };
+                    leaves.push_back(leaf);
+                }
+                for (size_t i = 0; i < split; i++)
+                {
+                    tree_position leaf = { ar_size + indices[i], depth - 1 };
+                    leaves.push_back(leaf);
+                }
+
+                // Large batches hand whole subtrees to threads
+                size_t level = subtree_level(threads, depth);
+                if (threads <= 1 || indices.size() < 2 * segment_tree_detail::parallel_grain || level == 0)
+                {
+                    update_ancestors(leaves, 0, leaves.size(), 0, &ar);
+                    return;
+                }
+
+                // Cut the leaves into chunks that never share a subtree at level
+                std::vector<size_t> cuts(1, 0);
+                for (unsigned c = 1; c < threads; c++)
+                {
+                    size_t cut = std::max(cuts.back(), leaves.size() * c / threads);
+                    while (cut > cuts.back() && cut < leaves.size() &&
+                           ancestor(leaves[cut], level) == ancestor(leaves[cut - 1], level))
+                    {
+                        cut++;
+                    }
+                    if (cut > cuts.back() && cut < leaves.size())
+                    {
+                        cuts.push_back(cut);
+                    }
+                }
+                cuts.push_back(leaves.size());
+                segment_tree_detail::parallel_for(0, cuts.size() - 1, threads, 1,
+                    [&]( size_t first, size_t last )
+                    {
+                        for (size_t c = first; c < last; c++)
+                        {
+                            update_ancestors(leaves, cuts[c], cuts[c + 1], level, &ar);
+                        }
+                    });
+
+                // Finish the levels above the subtrees on the calling thread
+                std::vector<tree_position> roots;
+                for (size_t i = 0; i < leaves.size(); i++)
+                {
+                    tree_position root;
+                    root.position = ancestor(leaves[i], level);
+                    root.depth = level;
+                    if (roots.empty() || roots.back().position != root.position)
+                    {
+                        roots.push_back(root);
+                    }
+                }
+                update_ancestors(roots, 0, roots.size(), 0, (const source*)NULL);
+            }
+
+            size_t memory_footprint() const
+            {
+                return sizeof(*this) + tree.capacity() * sizeof(node);
+            }
+
+        private:
+            merge_policy policy;
+            size_t ar_size;
+            std::vector<node> tree;
+
+            struct tree_position
+            {
+                size_t position;
+                size_t depth;
+            };
+
+            static size_t ancestor( const tree_position& x, size_t depth )
+            {
+                return x.position >> (x.depth - depth);
+            }
+
+            // Unless N is a power of two the leaves span two levels. The deeper
+            // one is at depth and starts at deepest, the largest power of two
+            // below 2N, and the shallower one is right above it.
+            void leaf_levels( size_t& deepest, size_t& depth ) const
+            {
+                deepest = 1;
+                depth = 0;
+                while (2 * deepest < 2 * ar_size)
+                {
+                    deepest *= 2;
+                    depth++;
+                }
+            }
+
+            // Level whose subtrees are independent and numerous enough to keep
+            // threads busy, or zero when the tree is too shallow to split
+            static size_t subtree_level( unsigned threads, size_t depth )
+            {
+                size_t level = 0;
+                while (((size_t)1 << level) < 4 * (size_t)threads && level + 1 < depth)
+                {
+                    level++;
+                }
+                return level;
+            }
+
+            // Builds the subtrees rooted at positions [first, last) of a single
+            // level. Their descendants at every depth form a contiguous range.
+            template < typename source >
+            void construct_subtrees( size_t first, size_t last, const source& ar )
+            {
+                size_t height = 0;
+                while ((first << (height + 1)) < 2 * ar_size)
+                {
+                    height++;
+                }
+                for (size_t d = height + 1; d-- > 0; )
+                {
+                    size_t lo = first << d;
+                    size_t hi = std::min(last << d, 2 * ar_size);
+                    for (size_t p = lo; p < hi; p++)
+                    {
+                        if (p >= ar_size)
+                        {
+                            policy.set_default_value(tree[p], ar[p - ar_size]);
+                        }
+                        else
+                        {
+                            segment_tree_detail::merge_into(policy, tree[p], tree[2 * p], tree[2 * p + 1]);
+                        }
+                    }
+                }
+            }
+
+            // Walks up from every node in [first, last), given in tree order, to
+            // stop_depth, first setting it from ar when it is a leaf. A walk stops
+            // below an ancestor it shares with the next node, so every ancestor is
+            // merged once, after all of its updated descendants and while they
+            // are likely still in cache.
+            template < typename source >
+            void update_ancestors( const std::vector<tree_position>& nodes, size_t first, size_t last, size_t stop_depth,
+                                   const source* ar )
+            {
+                for (size_t i = first; i < last; i++)
+                {
+                    size_t p = nodes[i].position;
+                    if (ar)
+                    {
+                        policy.set_default_value(tree[p], (*ar)[p - ar_size]);
+                    }
+                    for (size_t d = nodes[i].depth; d > stop_depth; d--)
+                    {
+                        p >>= 1;
+                        if (i + 1 < last && nodes[i + 1].depth >= d - 1 && ancestor(nodes[i + 1], d - 1) == p)
+                        {
+                            break;
+                        }
+                        segment_tree_detail::merge_into(policy, tree[p], tree[2 * p], tree[2 * p + 1]);
+                    }
+                }
+            }
+
+            node range_query( index_type lo, index_type hi, std::true_type )
+            {
+                // The left and right accumulators are kept apart so that
+                // the merge order matches the array order
+                node left_solution = segment_tree_identity<node>::value();
+                node right_solution = left_solution;
+                node solution = left_solution;
+                size_t l = ar_size + lo;
+                size_t r = ar_size + hi + 1;
+                for (; l < r; l >>= 1, r >>= 1)
+                {
+                    if (l & 1)
+                    {
+                        segment_tree_detail::merge_into(policy, solution, left_solution, tree[l]);
+                        std::swap(left_solution, solution);
+                        l++;
+                    }
+                    if (r & 1)
+                    {
+                        r--;
+                        segment_tree_detail::merge_into(policy, solution, tree[r], right_solution);
+                        std::swap(right_solution, solution);
+                    }
+                }
+                segment_tree_detail::merge_into(policy, solution, left_solution, right_solution);
+                return solution;
+            }
+
+            node range_query( index_type lo, index_type hi, std::false_type )
+            {
+                // The left and right accumulators are kept apart so that
+                // the merge order matches the array order
+                boost::optional<node> left_solution;
+                boost::optional<node> right_solution;
+                node solution;
+                size_t l = ar_size + lo;
+                size_t r = ar_size + hi + 1;
+                for (; l < r; l >>= 1, r >>= 1)
+                {
+                    if (l & 1)
+                    {
+                        if (left_solution)
+                        {
+                            segment_tree_detail::merge_into(policy, solution, *left_solution, tree[l]);
+                            std::swap(*left_solution, solution);
+                        }
+                        else
+                        {
+                            left_solution = tree[l];
+                        }
+                        l++;
+                    }
+                    if (r & 1)
+                    {
+                        r--;
+                        if (right_solution)
+                        {
+                            segment_tree_detail::merge_into(policy, solution, tree[r], *right_solution);
+                            std::swap(*right_solution, solution);
+                        }
+                        else
+                        {
+                            right_solution = tree[r];
+                        }
+                    }
+                }
+                if (!left_solution)
+                {
+                    return *right_solution;
+                }
+                if (!right_solution)
+                {
+                    return *left_solution;
+                }
+                segment_tree_detail::merge_into(policy, solution, *left_solution, *right_solution);
+                return solution;
+            }
+        };
+    };
+
+    // Top-down engine over a 4N + 2 node array in heap order
+    struct recursive
+    {
+        template <  typename        T,
+                    typename        node,
+                    typename        merge_policy,
+                    typename        index_type    >
+        using engine = segment_tree_detail::top_down_engine< T, node, merge_policy, segment_tree_detail::heap_layout, index_type >;
+    };
+
+    // Top-down engine over exactly 2N - 1 nodes in preorder
+    struct compact
+    {
+        template <  typename        T,
+                    typename        node,
+                    typename        merge_policy,
+                    typename        index_type    >
+        using engine = segment_tree_detail::top_down_engine< T, node, merge_policy, segment_tree_detail::preorder_layout, index_type >;
+    };
+}
+
+// Adapts set_default_value and merge function pointers to a merge policy
 template <  typename        T,
             typename        node,
-            void            (*set_default_value)(node&, T),
-            node           (*merge)(node*, node*)    >
-class segment_tree
+            void            (*set_default_value_ptr)(node&, T),
+            node           (*merge_ptr)(node*, node*)    >
+struct function_merge_policy
 {
-public:
-    segment_tree( size_t N )
-        : ar_size(N)
-        , ar(ar_size)
-        , tree(4 * ar_size + 2)
-        , left(4 * ar_size + 2)
-        , right(4 * ar_size + 2)
+    void set_default_value( node& x, const T& y ) const
     {
-        init_left_right(1, 0, ar_size - 1);
+        set_default_value_ptr(x, y);
     }
 
-    segment_tree( const std::vector<T>& init_ar )
-        : ar_size(init_ar.size())
-        , ar(init_ar)
-        , tree(4 * ar_size + 2)
-        , left(4 * ar_size + 2)
-        , right(4 * ar_size + 2)
+    void set_default_value( node& x, T&& y ) const
     {
-        init_left_right(1, 0, ar_size - 1);
-        construct_tree(1);
+        set_default_value_ptr(x, std::move(y));
     }
 
-    void construct_tree( const std::vector<T>& init_ar )
+    node merge( node* a, node* b ) const
     {
-        ar = init_ar;
-        construct_tree(1);
+        return merge_ptr(a, b);
     }
+};
 
-    size_t get_array_size()
+// Adapts a pair of callables, such as lambdas, to a merge policy
+template <  typename        set_default_value_fn,
+            typename        merge_fn    >
+struct callable_merge_policy
+{
+    set_default_value_fn set_default_value_callable;
+    merge_fn merge_callable;
+
+    callable_merge_policy( set_default_value_fn set_default_value, merge_fn merge )
+        : set_default_value_callable(set_default_value)
+        , merge_callable(merge)
     {
-        return ar_size;
     }
 
-    std::vector<T>& get_array()
+    template < typename node, typename T >
+    void set_default_value( node& x, T&& y ) const
     {
-        return ar;
+        set_default_value_callable(x, std::forward<T>(y));
     }
 
-    node range_query( int lo, int hi )
+    template < typename node >
+    auto merge( node* a, node* b ) const -> decltype(merge_callable(a, b))
     {
-        return *range_query(1, lo, hi);
+        return merge_callable(a, b);
     }
 
-    void point_update( int index, T new_value )
+    template < typename node >
+    auto merge( node& out, const node& a, const node& b ) const -> decltype(merge_callable(out, a, b))
     {
-        ar[index] = new_value;
-        update_tree_over_point(1, index);
+        return merge_callable(out, a, b);
     }
+};
 
-private:
-    size_t ar_size;
-    std::vector<T> ar;
-    std::vector<node> tree;
-    std::vector<int> left;
-    std::vector<int> right;
+namespace segment_tree_detail
+{
+    template < typename iterator, typename = void >
+    struct is_forward_iterator : std::false_type
+    {
+    };
+
+    template < typename iterator >
+    struct is_forward_iterator< iterator, typename make_void<typename std::iterator_traits<iterator>::iterator_category>::type >
+        : std::is_convertible<typename std::iterator_traits<iterator>::iterator_category, std::forward_iterator_tag>
+    {
+    };
+
+    template < typename iterator >
+    struct is_random_access_iterator
+        : std::is_convertible<typename std::iterator_traits<iterator>::iterator_category, std::random_access_iterator_tag>
+    {
+    };
+
+    // Element i is gen(i), computed when an engine reads it
+    template < typename generator >
+    class generated_array
+    {
+    public:
+        generated_array( generator& gen )
+            : gen(gen)
+        {
+        }
+
+        auto operator[]( size_t i ) const -> decltype(std::declval<generator&>()(i))
+        {
+            return gen(i);
+        }
+
+    private:
+        generator& gen;
+    };
 
-    void init_left_right( int node_index, int lo, int hi )
+    // The values of a batch of (index, value) updates by index, the last
+    // update of an index winning, for trees that keep no array. Only the
+    // updated indices can be read.
+    template < typename T, typename index_type >
+    class batch_values
     {
-        left[node_index] = lo;
-        right[node_index] = hi;
+    public:
+        // Fills indices with the updated indices, sorted and free of duplicates
+        batch_values( const std::vector<std::pair<index_type, T>>& updates, std::vector<index_type>& indices )
+            : updates(updates)
+            , indices(indices)
+        {
+            std::vector<size_t> order(updates.size());
+            for (size_t i = 0; i < order.size(); i++)
+            {
+                order[i] = i;
+            }
+            std::stable_sort(order.begin(), order.end(),
+                [&]( size_t a, size_t b )
+                {
+                    return updates[a].first < updates[b].first;
+                });
+            indices.clear();
+            for (size_t i = 0; i < order.size(); i++)
+            {
+                if (!indices.empty() && indices.back() == updates[order[i]].first)
+                {
+                    latest.back() = order[i];
+                }
+                else
+                {
+                    indices.push_back(updates[order[i]].first);
+                    latest.push_back(order[i]);
+                }
+            }
+        }
 
-        if (lo != hi)
+        const T& operator[]( size_t i ) const
         {
-            int mid = lo + (hi - lo) / 2;
-            init_left_right(2 * node_index, lo, mid);
-            init_left_right(2 * node_index + 1, mid + 1, hi);
+            size_t k = std::lower_bound(indices.begin(), indices.end(), (index_type)i) - indices.begin();
+            return updates[latest[k]].second;
         }
+
+    private:
+        const std::vector<std::pair<index_type, T>>& updates;
+        const std::vector<index_type>& indices;
+        std::vector<size_t> latest;
+    };
+}
+
+// A merge policy provides set_default_value(node&, const T&) and either
+// node merge(node*, node*) or void merge(node& out, const node& a, const node& b)
+// as const members and may carry runtime state. An overload of
+// set_default_value taking T&& is picked by point_update when the tree
+// keeps no array, and may take over the value instead of copying it. Positions are index_type,
+// which std::int64_t or std::uint64_t extends past 2^31 elements; node
+// positions are size_t whatever it is. With keep_array false the tree
+// keeps no copy of the array, which saves N elements when only the nodes
+// are needed, and get_array() is unavailable.
+template <  typename        T,
+            typename        node,
+            typename        merge_policy,
+            typename        backend = segment_tree_backend::iterative,
+            typename        index_type = int,
+            bool            keep_array = true    >
+class basic_segment_tree
+{
+public:
+    basic_segment_tree( size_t N, const merge_policy& policy = merge_policy() )
+        : ar_size(N)
+        , ar(keep_array ? ar_size : 0)
+        , tree(ar_size, policy)
+    {
     }
 
-    void construct_tree( int node_index )
+    // With threads > 1 independent subtrees of large arrays are built concurrently
+    basic_segment_tree( const std::vector<T>& init_ar, const merge_policy& policy = merge_policy(), unsigned threads = 1 )
+        : ar_size(init_ar.size())
+        , tree(ar_size, policy)
     {
-        int lo = left[node_index];
-        int hi = right[node_index];
-        if (lo == hi)
+        construct_tree(init_ar, threads);
+    }
+
+    // Takes over the storage of init_ar instead of copying it
+    basic_segment_tree( std::vector<T>&& init_ar, const merge_policy& policy = merge_policy(), unsigned threads = 1 )
+        : ar_size(init_ar.size())
+        , tree(ar_size, policy)
+    {
+        construct_tree(std::move(init_ar), threads);
+    }
+
+    // Reads the elements from the forward iterators [first, last) without
+    // an intermediate copy. Without a kept array they must be random
+    // access iterators.
+    template <  typename        iterator,
+                typename        = typename std::enable_if<segment_tree_detail::is_forward_iterator<iterator>::value>::type    >
+    basic_segment_tree( iterator first, iterator last, const merge_policy& policy = merge_policy(), unsigned threads = 1 )
+        : ar_size(std::distance(first, last))
+        , tree(ar_size, policy)
+    {
+        construct_tree(first, last, threads);
+    }
+
+    // Element i is gen(i) for i in [0, N). With threads > 1, gen is called
+    // from several threads at once.
+    template <  typename        generator,
+                typename        = decltype(T(std::declval<generator&>()(size_t())))    >
+    basic_segment_tree( size_t N, generator gen, const merge_policy& policy = merge_policy(), unsigned threads = 1 )
+        : ar_size(N)
+        , tree(ar_size, policy)
+    {
+        construct_tree(gen, threads);
+    }
+
+    void construct_tree( const std::vector<T>& init_ar, unsigned threads = 1 )
+    {
+        if (keep_array)
         {
-            set_default_value(tree[node_index], ar[lo]);
+            ar = init_ar;
+            tree.construct_tree(ar, threads);
         }
         else
         {
-            construct_tree(2 * node_index);
-            construct_tree(2 * node_index + 1);
-            tree[node_index] = merge(&tree[2 * node_index], &tree[2 * node_index + 1]);
+            tree.construct_tree(init_ar, threads);
         }
     }
 
-    boost::optional<node> range_query( int node_index, int lo, int hi )
+    void construct_tree( std::vector<T>&& init_ar, unsigned threads = 1 )
     {
-        // Interval doesn't intersect at all
-        if (lo > right[node_index] || hi < left[node_index])
+        if (keep_array)
         {
-            return boost::none;
+            ar = std::move(init_ar);
+            tree.construct_tree(ar, threads);
         }
-
-        // Interval completely contained
-        if (lo <= left[node_index] && hi >= right[node_index])
+        else
         {
-            return tree[node_index];
+            // Freed as soon as the nodes are built
+            std::vector<T> dropped(std::move(init_ar));
+            tree.construct_tree(dropped, threads);
         }
+    }
+
+    // When the array is not kept, the leaves are read from the iterators
+    // by position, so only random access iterators are accepted
+    template <  typename        iterator,
+                typename        = typename std::enable_if<segment_tree_detail::is_forward_iterator<iterator>::value>::type    >
+    void construct_tree( iterator first, iterator last, unsigned threads = 1 )
+    {
+        static_assert(keep_array || segment_tree_detail::is_random_access_iterator<iterator>::value,
+            "a tree without the array is built from random access iterators only");
+        construct_tree(first, last, threads, std::integral_constant<bool, keep_array>());
+    }
 
-        // Interval partially intersects
-        boost::optional<node> left_solution = range_query(2 * node_index, lo, hi);
-        boost::optional<node> right_solution = range_query(2 * node_index + 1, lo, hi);
-        if (!right_solution && !left_solution)
+    template <  typename        generator,
+                typename        = decltype(T(std::declval<generator&>()(size_t())))    >
+    void construct_tree( generator gen, unsigned threads = 1 )
+    {
+        if (keep_array)
         {
-            return boost::none;
+            ar.clear();
+            ar.reserve(ar_size);
+            for (size_t i = 0; i < ar_size; i++)
+            {
+                ar.push_back(gen(i));
+            }
+            tree.construct_tree(ar, threads);
         }
-        if (!left_solution && right_solution)
+        else
         {
-            return *right_solution;
+            tree.construct_tree(segment_tree_detail::generated_array<generator>(gen), threads);
         }
-        if (!right_solution && left_solution)
+    }
+
+    size_t get_array_size()
+    {
+        return ar_size;
+    }
+
+    std::vector<T>& get_array()
+    {
+        static_assert(keep_array, "the tree keeps no copy of the array");
+        return ar;
+    }
+
+    node range_query( index_type lo, index_type hi )
+    {
+        return tree.range_query(lo, hi);
+    }
+
+    void point_update( index_type index, T new_value )
+    {
+        if (keep_array)
         {
-            return *left_solution;
+            ar[index] = std::move(new_value);
+            tree.point_update(index, ar[index]);
         }
-        node ls = *left_solution;
-        node rs = *right_solution;
-        return merge(&ls, &rs);
+        else
+        {
+            tree.point_update(index, std::move(new_value));
+        }
+    }
+
+    // Answers every (lo, hi) query into results, resized to match, in the
+    // order of the queries. With threads > 1 the queries are spread over
+    // that many threads by work stealing. Nothing is allocated per query
+    // beyond what the nodes themselves allocate.
+    void range_query_batch( const std::vector<std::pair<index_type, index_type>>& queries, std::vector<node>& results, unsigned threads = 1 )
+    {
+        results.resize(queries.size());
+        segment_tree_detail::work_stealing_for(0, queries.size(), threads, segment_tree_detail::query_grain,
+            [&]( size_t begin, size_t end )
+            {
+                for (size_t i = begin; i < end; i++)
+                {
+                    results[i] = tree.range_query(queries[i].first, queries[i].second);
+                }
+            });
     }
 
-    void update_tree_over_point( int node_index, int index )
+    // Applies every (index, value) pair, later pairs winning on repeated
+    // indices. Each affected node is recomputed once, and with threads > 1
+    // large batches are spread over that many threads.
+    void point_update_batch( const std::vector<std::pair<index_type, T>>& updates, unsigned threads = 1 )
     {
-        // Interval doesn't contain index
-        if (index > right[node_index] || index < left[node_index])
+        std::vector<index_type> indices;
+        if (!keep_array)
         {
+            segment_tree_detail::batch_values<T, index_type> values(updates, indices);
+            tree.point_update_batch(indices, values, threads);
             return;
         }
 
-        // Interval has converged to index
-        if (left[node_index] == right[node_index])
+        indices.resize(updates.size());
+        for (size_t i = 0; i < updates.size(); i++)
         {
-            set_default_value(tree[node_index], ar[index]);
-            return;
+            ar[updates[i].first] = updates[i].second;
+            indices[i] = updates[i].first;
+        }
+        if (!std::is_sorted(indices.begin(), indices.end()))
+        {
+            std::sort(indices.begin(), indices.end());
         }
+        indices.erase(std::unique(indices.begin(), indices.end()), indices.end());
+        tree.point_update_batch(indices, ar, threads);
+    }
 
-        // Interval contains index
-        update_tree_over_point(2 * node_index, index);
-        node* left_solution = &tree[2 * node_index];
-        update_tree_over_point(2 * node_index + 1, index);
-        node* right_solution = &tree[2 * node_index + 1];
-        tree[node_index] = merge(left_solution, right_solution);
+    // Bytes held by this instance for the array and the node storage,
+    // not counting memory owned by the elements themselves
+    size_t memory_footprint() const
+    {
+        return sizeof(*this) - sizeof(tree) + ar.capacity() * sizeof(T) + tree.memory_footprint();
+    }
+
+private:
+    typedef typename backend::template engine<T, node, merge_policy, index_type> engine_type;
+
+    size_t ar_size;
+    std::vector<T> ar;
+    engine_type tree;
+
+    template < typename iterator >
+    void construct_tree( iterator first, iterator last, unsigned threads, std::true_type )
+    {
+        ar.assign(first, last);
+        tree.construct_tree(ar, threads);
+    }
+
+    template < typename iterator >
+    void construct_tree( iterator first, iterator, unsigned threads, std::false_type )
+    {
+        tree.construct_tree(first, threads);
     }
 };
 
+template <  typename        T,
+            typename        node,
+            void            (*set_default_value)(node&, T),
+            node           (*merge)(node*, node*),
+            typename        backend = segment_tree_backend::iterative,
+            typename        index_type = int,
+            bool            keep_array = true    >
+using segment_tree = basic_segment_tree< T, node, function_merge_policy<T, node, set_default_value, merge>, backend, index_type, keep_array >;
+
+// Builds a tree whose merge policy wraps the given callables
+template <  typename        T,
+            typename        node,
+            typename        backend = segment_tree_backend::iterative,
+            typename        set_default_value_fn,
+            typename        merge_fn    >
+basic_segment_tree< T, node, callable_merge_policy<set_default_value_fn, merge_fn>, backend >
+make_segment_tree( const std::vector<T>& init_ar, set_default_value_fn set_default_value, merge_fn merge )
+{
+    return basic_segment_tree< T, node, callable_merge_policy<set_default_value_fn, merge_fn>, backend >(
+        init_ar, callable_merge_policy<set_default_value_fn, merge_fn>(set_default_value, merge));
+}
+
 #endif
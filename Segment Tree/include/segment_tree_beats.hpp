@@ -0,0 +1,183 @@
+#ifndef SEGMENT_TREE_BEATS
+#define SEGMENT_TREE_BEATS
+
+#include "lazy_segment_tree.hpp"
+
+#include <vector>
+#include <limits>
+#include <algorithm>
+
+// Aggregate of a segment tree beats node. The second largest and second
+// smallest values are strict, a node holding a single distinct value
+// keeps the lowest and highest representable values there.
+template < typename V >
+struct beats_node
+{
+    V sum;
+    V max;
+    V second_max;
+    size_t max_count;
+    V min;
+    V second_min;
+    size_t min_count;
+};
+
+// Maps every element x of a range to min(max(x, lo), hi)
+template < typename V >
+struct clamp_map
+{
+    V lo;
+    V hi;
+};
+
+// Lazy policy clamping ranges of elements. A clamp only touches the
+// largest and smallest values of a node, so it is summarized at nodes
+// where it leaves the second largest and second smallest values alone
+// and pushed further down everywhere else.
+template < typename V >
+struct range_clamp_policy
+{
+    typedef clamp_map<V> tag_type;
+
+    void set_default_value( beats_node<V>& x, const V& y ) const
+    {
+        x.sum = y;
+        x.max = y;
+        x.second_max = std::numeric_limits<V>::lowest();
+        x.max_count = 1;
+        x.min = y;
+        x.second_min = std::numeric_limits<V>::max();
+        x.min_count = 1;
+    }
+
+    void merge( beats_node<V>& out, const beats_node<V>& a, const beats_node<V>& b ) const
+    {
+        out.sum = a.sum + b.sum;
+
+        if (a.max == b.max)
+        {
+            out.max = a.max;
+            out.second_max = std::max(a.second_max, b.second_max);
+            out.max_count = a.max_count + b.max_count;
+        }
+        else if (a.max > b.max)
+        {
+            out.max = a.max;
+            out.second_max = std::max(a.second_max, b.max);
+            out.max_count = a.max_count;
+        }
+        else
+        {
+            out.max = b.max;
+            out.second_max = std::max(a.max, b.second_max);
+            out.max_count = b.max_count;
+        }
+
+        if (a.min == b.min)
+        {
+            out.min = a.min;
+            out.second_min = std::min(a.second_min, b.second_min);
+            out.min_count = a.min_count + b.min_count;
+        }
+        else if (a.min < b.min)
+        {
+            out.min = a.min;
+            out.second_min = std::min(a.second_min, b.min);
+            out.min_count = a.min_count;
+        }
+        else
+        {
+            out.min = b.min;
+            out.second_min = std::min(a.min, b.second_min);
+            out.min_count = b.min_count;
+        }
+    }
+
+    bool can_apply( const beats_node<V>& x, const tag_type& f ) const
+    {
+        // Nodes with at most two distinct values are always summarized
+        if (x.second_max <= x.min)
+        {
+            return true;
+        }
+        return f.hi > x.second_max && f.lo < x.second_min;
+    }
+
+    void apply( beats_node<V>& x, const tag_type& f, size_t length ) const
+    {
+        V new_min = clamp(x.min, f);
+        V new_max = clamp(x.max, f);
+
+        // A single distinct value, either before or after the clamp
+        if (new_min == new_max)
+        {
+            x.sum = new_min * (V)length;
+            x.max = new_max;
+            x.second_max = std::numeric_limits<V>::lowest();
+            x.max_count = length;
+            x.min = new_min;
+            x.second_min = std::numeric_limits<V>::max();
+            x.min_count = length;
+            return;
+        }
+
+        x.sum += (new_min - x.min) * (V)x.min_count + (new_max - x.max) * (V)x.max_count;
+
+        // Exactly two distinct values, each one is the other's runner-up
+        if (x.second_max == x.min)
+        {
+            x.second_max = new_min;
+            x.second_min = new_max;
+        }
+        x.min = new_min;
+        x.max = new_max;
+    }
+
+    void compose( tag_type& existing, const tag_type& newer ) const
+    {
+        existing.lo = clamp(existing.lo, newer);
+        existing.hi = clamp(existing.hi, newer);
+    }
+
+    static V clamp( V x, const tag_type& f )
+    {
+        return std::min(std::max(x, f.lo), f.hi);
+    }
+};
+
+// Segment tree beats: range chmin and chmax in amortized O(log^2 N)
+// alongside range sum, minimum and maximum queries
+template < typename V, typename clamp_policy = range_clamp_policy<V> >
+class segment_tree_beats : public lazy_segment_tree< V, beats_node<V>, clamp_policy >
+{
+public:
+    segment_tree_beats( size_t N, const clamp_policy& policy = clamp_policy() )
+        : lazy_segment_tree< V, beats_node<V>, clamp_policy >(N, policy)
+    {
+    }
+
+    segment_tree_beats( const std::vector<V>& init_ar, const clamp_policy& policy = clamp_policy() )
+        : lazy_segment_tree< V, beats_node<V>, clamp_policy >(init_ar, policy)
+    {
+    }
+
+    // Replaces every x in [lo, hi] with min(x, value)
+    void range_chmin( int lo, int hi, V value )
+    {
+        clamp_map<V> f;
+        f.lo = std::numeric_limits<V>::lowest();
+        f.hi = value;
+        this->range_update(lo, hi, f);
+    }
+
+    // Replaces every x in [lo, hi] with max(x, value)
+    void range_chmax( int lo, int hi, V value )
+    {
+        clamp_map<V> f;
+        f.lo = value;
+        f.hi = std::numeric_limits<V>::max();
+        this->range_update(lo, hi, f);
+    }
+};
+
+#endif
@@ -0,0 +1,295 @@
+#ifndef SEGMENT_TREE_BUCKETED
+#define SEGMENT_TREE_BUCKETED
+
+#include "segment_tree.hpp"
+
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <type_traits>
+
+namespace segment_tree_detail
+{
+    template < typename merge_policy, typename node, typename = void >
+    struct has_merge_range : std::false_type
+    {
+    };
+
+    template < typename merge_policy, typename node >
+    struct has_merge_range< merge_policy, node, typename make_void<decltype(std::declval<const merge_policy&>().merge_range(
+        std::declval<node&>(), std::declval<const node*>(), std::declval<const node*>()))>::type > : std::true_type
+    {
+    };
+
+    template < typename merge_policy, typename node >
+    void merge_range( const merge_policy& policy, node& out, node* first, node* last, std::true_type )
+    {
+        policy.merge_range(out, first, last);
+    }
+
+    template < typename merge_policy, typename node >
+    void merge_range( const merge_policy& policy, node& out, node* first, node* last, std::false_type )
+    {
+        out = *first;
+        node scratch;
+        for (node* x = first + 1; x != last; x++)
+        {
+            merge_into(policy, scratch, out, *x);
+            std::swap(out, scratch);
+        }
+    }
+
+    // Writes the merge of the non-empty run [first, last) into out. Policies
+    // with a const merge_range(node& out, const node* first, const node* last)
+    // member fold the run themselves, typically with a loop the compiler can
+    // vectorize; the others fold it one merge at a time.
+    template < typename merge_policy, typename node >
+    void merge_range( const merge_policy& policy, node& out, node* first, node* last )
+    {
+        merge_range(policy, out, first, last, has_merge_range<merge_policy, node>());
+    }
+}
+
+namespace segment_tree_backend
+{
+    // Stops the tree at blocks of block_size consecutive leaves, stored
+    // densely in array order. An iterative tree over the M = N / block_size
+    // block aggregates answers the whole blocks of a query and the partial
+    // blocks at its ends are folded in place. Internal nodes drop from 2N to
+    // 2M, and a point update refolds one block before walking log M levels.
+    // The partial blocks cost up to 2 * block_size merges per query, so the
+    // block should stay small: 16 suits 4 byte nodes with a vectorizable
+    // merge_range, larger nodes or plain merges call for smaller blocks.
+    template < size_t block_size = 16 >
+    struct bucketed
+    {
+        static_assert(block_size > 0, "blocks need at least one leaf");
+
+        template <  typename        T,
+                    typename        node,
+                    typename        merge_policy,
+                    typename        index_type    >
+        class engine
+        {
+        public:
+            engine( size_t N, const merge_policy& policy )
+                : policy(policy)
+                , ar_size(N)
+                , blocks((N + block_size - 1) / block_size)
+                , leaves(ar_size)
+                , tree(2 * blocks)
+            {
+            }
+
+            template < typename source >
+            void construct_tree( const source& ar, unsigned threads )
+            {
+                segment_tree_detail::parallel_for(0, blocks, threads, segment_tree_detail::parallel_grain / block_size + 1,
+                    [&]( size_t first, size_t last )
+                    {
+                        for (size_t b = first; b < last; b++)
+                        {
+                            size_t end = std::min((b + 1) * block_size, ar_size);
+                            for (size_t i = b * block_size; i < end; i++)
+                            {
+                                policy.set_default_value(leaves[i], ar[i]);
+                            }
+                            refold_block(b);
+                        }
+                    });
+                for (size_t p = blocks - 1; p > 0; p--)
+                {
+                    segment_tree_detail::merge_into(policy, tree[p], tree[2 * p], tree[2 * p + 1]);
+                }
+            }
+
+            node range_query( index_type lo, index_type hi )
+            {
+                size_t lo_block = lo / block_size;
+                size_t hi_block = hi / block_size;
+                if (lo_block == hi_block)
+                {
+                    node solution;
+                    segment_tree_detail::merge_range(policy, solution, &leaves[lo], &leaves[hi] + 1);
+                    return solution;
+                }
+
+                // Partial blocks at the ends, whole blocks in between
+                bool lo_partial = lo % block_size != 0;
+                bool hi_partial = (size_t)hi + 1 != std::min((hi_block + 1) * block_size, ar_size);
+                size_t first_whole = lo_partial ? lo_block + 1 : lo_block;
+                size_t last_whole = hi_partial ? hi_block - 1 : hi_block;
+
+                // Value-initialized only to keep the accumulators well defined
+                // until they are started
+                node solution = node();
+                node piece = node();
+                node scratch = node();
+                bool started = false;
+                if (lo_partial)
+                {
+                    segment_tree_detail::merge_range(policy, solution, &leaves[lo], &leaves[0] + (lo_block + 1) * block_size);
+                    started = true;
+                }
+                if (first_whole <= last_whole)
+                {
+                    whole_blocks(first_whole, last_whole, piece);
+                    append(solution, piece, scratch, started);
+                }
+                if (hi_partial)
+                {
+                    segment_tree_detail::merge_range(policy, piece, &leaves[0] + hi_block * block_size, &leaves[hi] + 1);
+                    append(solution, piece, scratch, started);
+                }
+                return solution;
+            }
+
+            template < typename value_type >
+            void point_update( index_type index, value_type&& value )
+            {
+                policy.set_default_value(leaves[index], std::forward<value_type>(value));
+                size_t b = index / block_size;
+                refold_block(b);
+                for (size_t p = (blocks + b) >> 1; p > 0; p >>= 1)
+                {
+                    segment_tree_detail::merge_into(policy, tree[p], tree[2 * p], tree[2 * p + 1]);
+                }
+            }
+
+            // indices must be sorted and free of duplicates. Each touched block
+            // is refolded once, and every internal node above one of them is
+            // recomputed once.
+            template < typename source >
+            void point_update_batch( const std::vector<index_type>& indices, const source& ar, unsigned threads )
+            {
+                std::vector<size_t> touched;
+                for (size_t i = 0; i < indices.size(); i++)
+                {
+                    policy.set_default_value(leaves[indices[i]], ar[indices[i]]);
+                    size_t b = indices[i] / block_size;
+                    if (touched.empty() || touched.back() != b)
+                    {
+                        touched.push_back(b);
+                    }
+                }
+                segment_tree_detail::parallel_for(0, touched.size(), threads, segment_tree_detail::parallel_grain / block_size + 1,
+                    [&]( size_t first, size_t last )
+                    {
+                        for (size_t i = first; i < last; i++)
+                        {
+                            refold_block(touched[i]);
+                        }
+                    });
+
+                // Every ancestor once, children before parents since they
+                // have larger positions
+                std::vector<size_t> ancestors;
+                for (size_t i = 0; i < touched.size(); i++)
+                {
+                    for (size_t p = (blocks + touched[i]) >> 1; p > 0; p >>= 1)
+                    {
+                        ancestors.push_back(p);
+                    }
+                }
+                std::sort(ancestors.begin(), ancestors.end());
+                ancestors.erase(std::unique(ancestors.begin(), ancestors.end()), ancestors.end());
+                for (size_t i = ancestors.size(); i-- > 0; )
+                {
+                    size_t p = ancestors[i];
+                    segment_tree_detail::merge_into(policy, tree[p], tree[2 * p], tree[2 * p + 1]);
+                }
+            }
+
+            size_t memory_footprint() const
+            {
+                return sizeof(*this) + leaves.capacity() * sizeof(node) + tree.capacity() * sizeof(node);
+            }
+
+        private:
+            merge_policy policy;
+            size_t ar_size;
+            size_t blocks;
+            std::vector<node> leaves;
+            std::vector<node> tree;
+
+            void refold_block( size_t b )
+            {
+                size_t end = std::min((b + 1) * block_size, ar_size);
+                segment_tree_detail::merge_range(policy, tree[blocks + b], &leaves[0] + b * block_size, &leaves[0] + end);
+            }
+
+            // Merges piece after solution, or starts solution with it
+            void append( node& solution, node& piece, node& scratch, bool& started )
+            {
+                if (!started)
+                {
+                    std::swap(solution, piece);
+                    started = true;
+                    return;
+                }
+                segment_tree_detail::merge_into(policy, scratch, solution, piece);
+                std::swap(solution, scratch);
+            }
+
+            // Merge of the whole blocks [first, last] with the two-pointer walk
+            // of the iterative engine, keeping the array order
+            void whole_blocks( size_t first, size_t last, node& solution )
+            {
+                node left_solution = node();
+                node right_solution = node();
+                node scratch = node();
+                bool left_started = false;
+                bool right_started = false;
+                size_t l = blocks + first;
+                size_t r = blocks + last + 1;
+                for (; l < r; l >>= 1, r >>= 1)
+                {
+                    if (l & 1)
+                    {
+                        accumulate(left_solution, tree[l], scratch, left_started, false);
+                        l++;
+                    }
+                    if (r & 1)
+                    {
+                        r--;
+                        accumulate(right_solution, tree[r], scratch, right_started, true);
+                    }
+                }
+                if (!left_started)
+                {
+                    std::swap(solution, right_solution);
+                }
+                else if (!right_started)
+                {
+                    std::swap(solution, left_solution);
+                }
+                else
+                {
+                    segment_tree_detail::merge_into(policy, solution, left_solution, right_solution);
+                }
+            }
+
+            // Merges x after or before an accumulator, or starts it with a copy of x
+            void accumulate( node& accumulator, node& x, node& scratch, bool& started, bool before )
+            {
+                if (!started)
+                {
+                    accumulator = x;
+                    started = true;
+                    return;
+                }
+                if (before)
+                {
+                    segment_tree_detail::merge_into(policy, scratch, x, accumulator);
+                }
+                else
+                {
+                    segment_tree_detail::merge_into(policy, scratch, accumulator, x);
+                }
+                std::swap(accumulator, scratch);
+            }
+        };
+    };
+}
+
+#endif
@@ -0,0 +1,190 @@
+#ifndef SEGMENT_TREE_FENWICK
+#define SEGMENT_TREE_FENWICK
+
+#include "segment_tree.hpp"
+
+#include <vector>
+#include <utility>
+#include <type_traits>
+
+// Specialize for a node type with a static value(const node& x) returning
+// the inverse of x under its merge, so that merging x with its inverse
+// gives the identity. Together with segment_tree_identity this makes the
+// Fenwick backend available for the node type.
+template < typename node >
+struct segment_tree_inverse
+{
+};
+
+namespace segment_tree_detail
+{
+    template < typename node, typename = void >
+    struct has_inverse : std::false_type
+    {
+    };
+
+    template < typename node >
+    struct has_inverse< node, typename make_void<decltype(segment_tree_inverse<node>::value(std::declval<const node&>()))>::type > : std::true_type
+    {
+    };
+}
+
+namespace segment_tree_backend
+{
+    // Fenwick tree over N + 1 nodes for commutative merges with an identity
+    // and an inverse. Node i aggregates the i & -i elements ending at i - 1,
+    // so prefixes walk down by clearing low bits, updates walk up by adding
+    // them, and a range is a prefix merged with the inverse of a shorter one.
+    struct fenwick
+    {
+        template <  typename        T,
+                    typename        node,
+                    typename        merge_policy,
+                    typename        index_type    >
+        class engine
+        {
+            static_assert(segment_tree_detail::has_identity<node>::value,
+                "the Fenwick backend needs segment_tree_identity specialized for the node type");
+            static_assert(segment_tree_detail::has_inverse<node>::value,
+                "the Fenwick backend needs segment_tree_inverse specialized for the node type");
+
+        public:
+            engine( size_t N, const merge_policy& policy )
+                : policy(policy)
+                , ar_size(N)
+                , tree(ar_size + 1, segment_tree_identity<node>::value())
+            {
+            }
+
+            // Linear build, every node hands its aggregate to its parent once.
+            // It is memory bound, so it runs on the calling thread regardless
+            // of threads.
+            template < typename source >
+            void construct_tree( const source& ar, unsigned threads )
+            {
+                (void)threads;
+                tree[0] = segment_tree_identity<node>::value();
+                for (size_t i = 1; i <= ar_size; i++)
+                {
+                    policy.set_default_value(tree[i], ar[i - 1]);
+                }
+                node scratch;
+                for (size_t i = 1; i <= ar_size; i++)
+                {
+                    size_t parent = i + (i & (0 - i));
+                    if (parent <= ar_size)
+                    {
+                        segment_tree_detail::merge_into(policy, scratch, tree[parent], tree[i]);
+                        std::swap(tree[parent], scratch);
+                    }
+                }
+            }
+
+            node range_query( index_type lo, index_type hi )
+            {
+                node solution = prefix_query(hi + 1);
+                if (lo == 0)
+                {
+                    return solution;
+                }
+                node excluded = segment_tree_inverse<node>::value(prefix_query(lo));
+                node scratch;
+                segment_tree_detail::merge_into(policy, scratch, solution, excluded);
+                return scratch;
+            }
+
+            template < typename value_type >
+            void point_update( index_type index, value_type&& value )
+            {
+                // The change is the new leaf merged with the inverse of the old one
+                node leaf;
+                policy.set_default_value(leaf, std::forward<value_type>(value));
+                node old_leaf = segment_tree_inverse<node>::value(leaf_value(index + 1));
+                node delta;
+                segment_tree_detail::merge_into(policy, delta, leaf, old_leaf);
+                add(index + 1, delta);
+            }
+
+            // Batches large enough to touch most nodes anyway are cheaper
+            // to apply by rebuilding from the array
+            void point_update_batch( const std::vector<index_type>& indices, const std::vector<T>& ar, unsigned threads )
+            {
+                size_t log_size = 1;
+                while (((size_t)1 << log_size) < ar_size)
+                {
+                    log_size++;
+                }
+                if (indices.size() * log_size >= ar_size)
+                {
+                    construct_tree(ar, threads);
+                    return;
+                }
+                for (size_t i = 0; i < indices.size(); i++)
+                {
+                    point_update(indices[i], ar[indices[i]]);
+                }
+            }
+
+            // Other sources only hold the values at indices, so there is
+            // nothing to rebuild from
+            template < typename source >
+            void point_update_batch( const std::vector<index_type>& indices, const source& ar, unsigned )
+            {
+                for (size_t i = 0; i < indices.size(); i++)
+                {
+                    point_update(indices[i], ar[indices[i]]);
+                }
+            }
+
+            size_t memory_footprint() const
+            {
+                return sizeof(*this) + tree.capacity() * sizeof(node);
+            }
+
+        private:
+            merge_policy policy;
+            size_t ar_size;
+            std::vector<node> tree;
+
+            // Merge of the first count elements
+            node prefix_query( size_t count )
+            {
+                node solution = segment_tree_identity<node>::value();
+                node scratch;
+                for (size_t i = count; i > 0; i &= i - 1)
+                {
+                    segment_tree_detail::merge_into(policy, scratch, solution, tree[i]);
+                    std::swap(solution, scratch);
+                }
+                return solution;
+            }
+
+            // Element i - 1 on its own, node i without the nodes it covers
+            node leaf_value( size_t i )
+            {
+                node solution = tree[i];
+                node scratch;
+                size_t stop = i & (i - 1);
+                for (size_t j = i - 1; j > stop; j &= j - 1)
+                {
+                    node excluded = segment_tree_inverse<node>::value(tree[j]);
+                    segment_tree_detail::merge_into(policy, scratch, solution, excluded);
+                    std::swap(solution, scratch);
+                }
+                return solution;
+            }
+
+            void add( size_t i, node& delta )
+            {
+                node scratch;
+                for (; i <= ar_size; i += i & (0 - i))
+                {
+                    segment_tree_detail::merge_into(policy, scratch, tree[i], delta);
+                    std::swap(tree[i], scratch);
+                }
+            }
+        };
+    };
+}
+
+#endif
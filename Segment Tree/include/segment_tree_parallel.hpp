@@ -0,0 +1,112 @@
+#ifndef SEGMENT_TREE_PARALLEL
+#define SEGMENT_TREE_PARALLEL
+
+#include <vector>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <algorithm>
+
+namespace segment_tree_detail
+{
+    // Splits [begin, end) into contiguous chunks of at least min_chunk items,
+    // one per thread, and runs body(chunk_begin, chunk_end) on each of them.
+    // The calling thread takes the first chunk and waits for the rest.
+    template < typename F >
+    void parallel_for( size_t begin, size_t end, unsigned threads, size_t min_chunk, F body )
+    {
+        size_t count = end - begin;
+        size_t chunks = std::min<size_t>(threads, count / std::max<size_t>(min_chunk, 1));
+        if (chunks <= 1)
+        {
+            body(begin, end);
+            return;
+        }
+
+        std::vector<std::thread> workers;
+        workers.reserve(chunks - 1);
+        for (size_t c = 1; c < chunks; c++)
+        {
+            size_t chunk_begin = begin + count * c / chunks;
+            size_t chunk_end = begin + count * (c + 1) / chunks;
+            workers.push_back(std::thread([=]() { body(chunk_begin, chunk_end); }));
+        }
+        body(begin, begin + count / chunks);
+        for (size_t c = 0; c < workers.size(); c++)
+        {
+            workers[c].join();
+        }
+    }
+
+    // Runs body(chunk_begin, chunk_end) over [begin, end) in chunks of grain
+    // items on up to threads threads. Each thread starts on a contiguous
+    // share of its own, so what it writes stays in one stretch of memory,
+    // and once its share is done it takes chunks from the shares of the
+    // others, so a thread that lags does not hold up the rest.
+    template < typename F >
+    void work_stealing_for( size_t begin, size_t end, unsigned threads, size_t grain, F body )
+    {
+        size_t count = end - begin;
+        grain = std::max<size_t>(grain, 1);
+        size_t shares = std::min<size_t>(threads, (count + grain - 1) / grain);
+        if (shares <= 1)
+        {
+            body(begin, end);
+            return;
+        }
+
+        // The next unclaimed item of each share, on a cache line of its own
+        struct share
+        {
+            std::atomic<size_t> next;
+            size_t end;
+            char padding[64 - sizeof(std::atomic<size_t>) - sizeof(size_t)];
+        };
+        std::unique_ptr<share[]> queue(new share[shares]);
+        for (size_t s = 0; s < shares; s++)
+        {
+            queue[s].next.store(begin + count * s / shares);
+            queue[s].end = begin + count * (s + 1) / shares;
+        }
+
+        auto worker = [&]( size_t own )
+        {
+            for (size_t k = 0; k < shares; k++)
+            {
+                share& victim = queue[(own + k) % shares];
+                for (;;)
+                {
+                    size_t chunk_begin = victim.next.fetch_add(grain);
+                    if (chunk_begin >= victim.end)
+                    {
+                        break;
+                    }
+                    body(chunk_begin, std::min(chunk_begin + grain, victim.end));
+                }
+            }
+        };
+
+        std::vector<std::thread> workers;
+        workers.reserve(shares - 1);
+        for (size_t s = 1; s < shares; s++)
+        {
+            workers.push_back(std::thread(worker, s));
+        }
+        worker(0);
+        for (size_t s = 0; s < workers.size(); s++)
+        {
+            workers[s].join();
+        }
+    }
+
+    // Runs left() on a new thread and right() on the calling one
+    template < typename F, typename G >
+    void parallel_invoke( F left, G right )
+    {
+        std::thread worker(left);
+        right();
+        worker.join();
+    }
+}
+
+#endif
@@ -0,0 +1,112 @@
+#ifndef SEGMENT_TREE_POOL
+#define SEGMENT_TREE_POOL
+
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <stdexcept>
+
+namespace segment_tree_detail
+{
+    // Allocator for the linked trees, handing out 32-bit handles to entries
+    // stored in chunks of 2^chunk_bits. Chunks never move, so references
+    // to entries stay valid while others are allocated, and released
+    // entries are reused before a new chunk is added. Handle 0 is never
+    // allocated and stands for a missing child.
+    template <  typename        entry,
+                size_t          chunk_bits = 12    >
+    class node_pool
+    {
+    public:
+        typedef std::uint32_t handle;
+
+        static const handle null = 0;
+
+        node_pool()
+            : next(1)
+            , live(0)
+        {
+        }
+
+        entry& operator[]( handle h )
+        {
+            return chunks[h >> chunk_bits][h & (chunk_size - 1)];
+        }
+
+        const entry& operator[]( handle h ) const
+        {
+            return chunks[h >> chunk_bits][h & (chunk_size - 1)];
+        }
+
+        // Returns a handle to a value-initialized entry. Throws
+        // std::length_error once every 32-bit handle is in use.
+        handle allocate()
+        {
+            if (!released.empty())
+            {
+                live++;
+                handle h = released.back();
+                released.pop_back();
+                return h;
+            }
+            if (next == 0)
+            {
+                throw std::length_error("node_pool: out of 32-bit handles");
+            }
+            live++;
+            if ((next >> chunk_bits) == chunks.size())
+            {
+                chunks.push_back(std::unique_ptr<entry[]>(new entry[chunk_size]()));
+            }
+            return next++;
+        }
+
+        // The entry is reset right away, freeing whatever memory it owns
+        void release( handle h )
+        {
+            (*this)[h] = entry();
+            released.push_back(h);
+            live--;
+        }
+
+        // Releases every entry at once, keeping the chunks for reuse
+        void clear()
+        {
+            for (handle h = 1; h < next; h++)
+            {
+                (*this)[h] = entry();
+            }
+            released.clear();
+            next = 1;
+            live = 0;
+        }
+
+        size_t live_entries() const
+        {
+            return live;
+        }
+
+        size_t memory_footprint() const
+        {
+            return chunks.capacity() * sizeof(std::unique_ptr<entry[]>) + chunks.size() * chunk_size * sizeof(entry)
+                + released.capacity() * sizeof(handle);
+        }
+
+    private:
+        static const size_t chunk_size = (size_t)1 << chunk_bits;
+
+        std::vector<std::unique_ptr<entry[]>> chunks;
+        std::vector<handle> released;
+        handle next;
+        size_t live;
+    };
+
+    // Definitions for when the constants are bound to references
+    template < typename entry, size_t chunk_bits >
+    const typename node_pool<entry, chunk_bits>::handle node_pool<entry, chunk_bits>::null;
+
+    template < typename entry, size_t chunk_bits >
+    const size_t node_pool<entry, chunk_bits>::chunk_size;
+}
+
+#endif
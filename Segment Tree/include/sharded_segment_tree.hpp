@@ -0,0 +1,403 @@
+#ifndef SHARDED_SEGMENT_TREE
+#define SHARDED_SEGMENT_TREE
+
+#include "segment_tree.hpp"
+#include "segment_tree_parallel.hpp"
+
+#include <mutex>
+#include <deque>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <condition_variable>
+
+// Splits the array into contiguous shards, each with its own tree and
+// lock, so that updates to different shards never wait for each other.
+// Every shard belongs to one of a fixed set of worker threads, and a
+// batch is routed by shard and applied by the workers of the shards it
+// touches. The assignment is logical only, the workers are not bound to
+// processors. A small tree over the shard roots answers the shards a
+// query covers completely; only the shards holding its ends are queried
+// directly.
+//
+// Updates do not touch the tree over the roots, they only count the
+// changes to their shard. A query brings the roots it needs up to date
+// before reading that tree: it copies each outdated root under the
+// shard's lock, waiting for a batch in progress on that shard, and then
+// takes the lock of the tree over the roots just to write the copy. No
+// lock is held while waiting for another, and queries spanning three or
+// more shards wait for each other only while they write or read roots.
+//
+// Queries and updates may run from any number of threads. A query sees
+// every update that returned before it started, but reads its shards one
+// after another, so it may see a concurrent batch in some shards and not
+// in others.
+template <  typename        T,
+            typename        node,
+            typename        merge_policy,
+            typename        backend = segment_tree_backend::iterative    >
+class basic_sharded_segment_tree
+{
+public:
+    // Builds min(max(shards, 1), N) shards whose sizes differ by at most
+    // one, so an empty array has none. Shard s belongs to worker
+    // s % threads, and the shards are built on as many threads.
+    basic_sharded_segment_tree( const std::vector<T>& init_ar, size_t shards, const merge_policy& policy = merge_policy(), unsigned threads = 1 )
+        : policy(policy)
+        , ar_size(init_ar.size())
+        , shard_size(0)
+        , larger_shards(0)
+    {
+        size_t count = std::min(std::max<size_t>(shards, 1), ar_size);
+        if (count == 0)
+        {
+            return;
+        }
+        shard_size = ar_size / count;
+        larger_shards = ar_size % count;
+        this->shards.resize(count);
+        std::vector<node> roots(count);
+        segment_tree_detail::parallel_for(0, count, threads, 1,
+            [&]( size_t begin, size_t end )
+            {
+                for (size_t s = begin; s < end; s++)
+                {
+                    typename std::vector<T>::const_iterator first = init_ar.begin() + shard_begin(s);
+                    typename std::vector<T>::const_iterator last = init_ar.begin() + shard_begin(s + 1);
+                    this->shards[s].reset(new shard(first, last, policy));
+                    this->shards[s]->snapshot(roots[s]);
+                }
+            });
+        top.reset(new top_tree(roots, root_policy(policy)));
+
+        workers.resize(std::min<size_t>(std::max(threads, 1u), count));
+        for (size_t w = 0; w < workers.size(); w++)
+        {
+            workers[w].reset(new worker());
+            workers[w]->thread = std::thread(&basic_sharded_segment_tree::work, this, std::ref(*workers[w]));
+        }
+    }
+
+    // Lets the workers finish what they were given and stops them
+    ~basic_sharded_segment_tree()
+    {
+        for (size_t w = 0; w < workers.size(); w++)
+        {
+            {
+                std::lock_guard<std::mutex> lock(workers[w]->lock);
+                workers[w]->stop = true;
+            }
+            workers[w]->wake.notify_one();
+            workers[w]->thread.join();
+        }
+    }
+
+    basic_sharded_segment_tree( const basic_sharded_segment_tree& ) = delete;
+    basic_sharded_segment_tree& operator=( const basic_sharded_segment_tree& ) = delete;
+
+    size_t get_array_size()
+    {
+        return ar_size;
+    }
+
+    size_t shard_count() const
+    {
+        return shards.size();
+    }
+
+    node range_query( int lo, int hi )
+    {
+        size_t first = shard_of(lo);
+        size_t last = shard_of(hi);
+        if (first == last)
+        {
+            return shards[first]->range_query(lo - shard_begin(first), hi - shard_begin(first));
+        }
+
+        node solution = shards[first]->range_query(lo - shard_begin(first), shards[first]->size() - 1);
+        node scratch;
+        if (first + 1 < last)
+        {
+            for (size_t s = first + 1; s < last; s++)
+            {
+                refresh_root(s);
+            }
+            node middle;
+            {
+                std::lock_guard<std::mutex> lock(top_lock);
+                middle = top->range_query(first + 1, last - 1);
+            }
+            segment_tree_detail::merge_into(policy, scratch, solution, middle);
+            std::swap(solution, scratch);
+        }
+        node tail = shards[last]->range_query(0, hi - shard_begin(last));
+        segment_tree_detail::merge_into(policy, scratch, solution, tail);
+        return scratch;
+    }
+
+    void point_update( int index, const T& new_value )
+    {
+        size_t s = shard_of(index);
+        shard& owner = *shards[s];
+        std::lock_guard<std::mutex> lock(owner.lock);
+        owner.tree.point_update(index - shard_begin(s), new_value);
+        owner.version++;
+    }
+
+    // Routes every (index, value) pair to its shard, later pairs winning on
+    // repeated indices, hands each shard's part to the shard's worker as
+    // one batch, and returns once all of them are applied
+    void point_update_batch( const std::vector<std::pair<int, T>>& updates )
+    {
+        std::vector<std::vector<std::pair<int, T>>> routed(shards.size());
+        for (size_t i = 0; i < updates.size(); i++)
+        {
+            size_t s = shard_of(updates[i].first);
+            routed[s].push_back(std::make_pair(updates[i].first - (int)shard_begin(s), updates[i].second));
+        }
+        std::vector<size_t> touched;
+        for (size_t s = 0; s < routed.size(); s++)
+        {
+            if (!routed[s].empty())
+            {
+                touched.push_back(s);
+            }
+        }
+
+        if (touched.empty())
+        {
+            return;
+        }
+
+        latch done(touched.size());
+        for (size_t i = 0; i < touched.size(); i++)
+        {
+            size_t s = touched[i];
+            worker& owner = *workers[s % workers.size()];
+            {
+                std::lock_guard<std::mutex> lock(owner.lock);
+                owner.jobs.push_back(job(s, &routed[s], &done));
+            }
+            owner.wake.notify_one();
+        }
+        done.wait();
+    }
+
+    // Bytes held by this instance for the shards, the tree over them and
+    // the workers
+    size_t memory_footprint() const
+    {
+        size_t bytes = sizeof(*this) + shards.capacity() * sizeof(shards[0]) + workers.capacity() * (sizeof(workers[0]) + sizeof(worker));
+        if (top)
+        {
+            bytes += top->memory_footprint();
+        }
+        for (size_t s = 0; s < shards.size(); s++)
+        {
+            bytes += sizeof(shard) - sizeof(shard_tree) + shards[s]->tree.memory_footprint();
+        }
+        return bytes;
+    }
+
+private:
+    typedef basic_segment_tree<T, node, merge_policy, backend> shard_tree;
+
+    // The tree over the roots stores shard roots as its elements
+    struct root_policy
+    {
+        merge_policy policy;
+
+        root_policy( const merge_policy& policy )
+            : policy(policy)
+        {
+        }
+
+        void set_default_value( node& x, const node& y ) const
+        {
+            x = y;
+        }
+
+        node merge( node* a, node* b ) const
+        {
+            node result;
+            segment_tree_detail::merge_into(policy, result, *a, *b);
+            return result;
+        }
+    };
+
+    typedef basic_segment_tree<node, node, root_policy> top_tree;
+
+    // version counts the changes made under lock, published the ones the
+    // tree over the roots has seen, which is written under top_lock
+    struct shard
+    {
+        shard_tree tree;
+        std::mutex lock;
+        std::atomic<size_t> version;
+        std::atomic<size_t> published;
+
+        template < typename iterator >
+        shard( iterator first, iterator last, const merge_policy& policy )
+            : tree(first, last, policy)
+            , version(0)
+            , published(0)
+        {
+        }
+
+        size_t size()
+        {
+            return tree.get_array_size();
+        }
+
+        // Copies the root and returns the version it belongs to
+        size_t snapshot( node& root )
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            root = tree.range_query(0, (int)size() - 1);
+            return version.load();
+        }
+
+        node range_query( int lo, int hi )
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            return tree.range_query(lo, hi);
+        }
+    };
+
+    // Counts down the shards of a batch as their workers finish them
+    struct latch
+    {
+        std::mutex lock;
+        std::condition_variable finished;
+        size_t remaining;
+
+        latch( size_t count )
+            : remaining(count)
+        {
+        }
+
+        void count_down()
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            if (--remaining == 0)
+            {
+                finished.notify_all();
+            }
+        }
+
+        void wait()
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            finished.wait(guard, [this]() { return remaining == 0; });
+        }
+    };
+
+    // One shard's part of a batch, owned by the caller waiting on done
+    struct job
+    {
+        size_t shard_index;
+        const std::vector<std::pair<int, T>>* updates;
+        latch* done;
+
+        job( size_t shard_index, const std::vector<std::pair<int, T>>* updates, latch* done )
+            : shard_index(shard_index)
+            , updates(updates)
+            , done(done)
+        {
+        }
+    };
+
+    struct worker
+    {
+        std::mutex lock;
+        std::condition_variable wake;
+        std::deque<job> jobs;
+        bool stop;
+        std::thread thread;
+
+        worker()
+            : stop(false)
+        {
+        }
+    };
+
+    merge_policy policy;
+    size_t ar_size;
+    size_t shard_size;
+    size_t larger_shards;
+    std::vector<std::unique_ptr<shard>> shards;
+    std::unique_ptr<top_tree> top;
+    std::mutex top_lock;
+    std::vector<std::unique_ptr<worker>> workers;
+
+    // The first larger_shards shards hold one element more than the rest
+    size_t shard_begin( size_t s ) const
+    {
+        return s * shard_size + std::min(s, larger_shards);
+    }
+
+    size_t shard_of( size_t index ) const
+    {
+        size_t larger_end = larger_shards * (shard_size + 1);
+        return index < larger_end ? index / (shard_size + 1) : larger_shards + (index - larger_end) / shard_size;
+    }
+
+    // Brings the root of shard s in the tree over the roots up to at least
+    // the version the shard had on entry. Queries refreshing the same shard
+    // may finish in any order, so a copy older than the one already
+    // written is dropped.
+    void refresh_root( size_t s )
+    {
+        shard& owner = *shards[s];
+        if (owner.published.load() >= owner.version.load())
+        {
+            return;
+        }
+        node root;
+        size_t version = owner.snapshot(root);
+        std::lock_guard<std::mutex> lock(top_lock);
+        if (version > owner.published.load())
+        {
+            top->point_update((int)s, root);
+            owner.published.store(version);
+        }
+    }
+
+    // Applies the jobs given to w in order until the tree is destroyed
+    void work( worker& w )
+    {
+        std::unique_lock<std::mutex> lock(w.lock);
+        for (;;)
+        {
+            w.wake.wait(lock, [&w]() { return w.stop || !w.jobs.empty(); });
+            if (w.jobs.empty())
+            {
+                return;
+            }
+            job next = w.jobs.front();
+            w.jobs.pop_front();
+            lock.unlock();
+
+            shard& owner = *shards[next.shard_index];
+            {
+                std::lock_guard<std::mutex> guard(owner.lock);
+                owner.tree.point_update_batch(*next.updates);
+                owner.version++;
+            }
+            next.done->count_down();
+            lock.lock();
+        }
+    }
+};
+
+template <  typename        T,
+            typename        node,
+            void            (*set_default_value)(node&, T),
+            node           (*merge)(node*, node*),
+            typename        backend = segment_tree_backend::iterative    >
+using sharded_segment_tree = basic_sharded_segment_tree< T, node, function_merge_policy<T, node, set_default_value, merge>, backend >;
+
+#endif
@@ -0,0 +1,306 @@
+#ifndef SPARSE_SEGMENT_TREE
+#define SPARSE_SEGMENT_TREE
+
+#include "segment_tree.hpp"
+#include "segment_tree_pool.hpp"
+
+#include <vector>
+#include <cstdint>
+#include <utility>
+
+// Segment tree over the 64-bit positions [0, N) that creates nodes on the
+// first update below them. Positions never updated hold the identity of
+// the merge, so the node type needs a segment_tree_identity
+// specialization, and subtrees without an updated position are never
+// allocated. Memory grows with the updated positions, at most
+// log2(N) + 1 pooled nodes each, and not with N. Takes the same node
+// types and merge policies as basic_segment_tree.
+template <  typename        T,
+            typename        node,
+            typename        merge_policy    >
+class basic_sparse_segment_tree
+{
+    static_assert(segment_tree_detail::has_identity<node>::value,
+        "untouched positions hold the identity, specialize segment_tree_identity for the node type");
+
+public:
+    typedef std::uint64_t index_type;
+
+    basic_sparse_segment_tree( index_type N, const merge_policy& policy = merge_policy() )
+        : policy(policy)
+        , ar_size(N)
+        , identity(segment_tree_identity<node>::value())
+        , root(pool_type::null)
+    {
+    }
+
+    index_type get_array_size()
+    {
+        return ar_size;
+    }
+
+    node range_query( index_type lo, index_type hi )
+    {
+        node solution = identity;
+        node scratch = identity;
+        range_query(root, 0, ar_size - 1, lo, hi, solution, scratch);
+        return solution;
+    }
+
+    // Answers every (lo, hi) query into results, resized to match, in the
+    // order of the queries. With threads > 1 the queries are spread over
+    // that many threads by work stealing. Once the nodes outgrow the caches
+    // each thread walks several queries down the tree in lockstep, one node
+    // per turn, and prefetches the children a query goes to next while the
+    // others take their turns. The children's locations come out of their
+    // parents, so a single query waits on every cache miss, whereas
+    // interleaved ones overlap them.
+    void range_query_batch( const std::vector<std::pair<index_type, index_type>>& queries, std::vector<node>& results, unsigned threads = 1 )
+    {
+        results.resize(queries.size());
+        bool interleave = pool.memory_footprint() >= segment_tree_detail::interleave_bytes;
+        segment_tree_detail::work_stealing_for(0, queries.size(), threads, segment_tree_detail::query_grain,
+            [&]( size_t begin, size_t end )
+            {
+                if (interleave)
+                {
+                    range_query_lockstep(queries, begin, end, results);
+                    return;
+                }
+                for (size_t i = begin; i < end; i++)
+                {
+                    results[i] = range_query(queries[i].first, queries[i].second);
+                }
+            });
+    }
+
+    void point_update( index_type index, const T& new_value )
+    {
+        // Descend to the leaf, creating what is missing on the way
+        handle path[64];
+        size_t depth = 0;
+        if (root == pool_type::null)
+        {
+            root = pool.allocate();
+        }
+        handle v = root;
+        index_type node_lo = 0;
+        index_type node_hi = ar_size - 1;
+        while (node_lo != node_hi)
+        {
+            path[depth++] = v;
+            index_type mid = node_lo + (node_hi - node_lo) / 2;
+            // Pooled entries never move, so the reference survives the allocation
+            handle& child = index <= mid ? pool[v].left : pool[v].right;
+            if (index <= mid)
+            {
+                node_hi = mid;
+            }
+            else
+            {
+                node_lo = mid + 1;
+            }
+            if (child == pool_type::null)
+            {
+                child = pool.allocate();
+            }
+            v = child;
+        }
+        policy.set_default_value(pool[v].value, new_value);
+
+        // Recompute the path bottom up, a missing child standing for the identity
+        while (depth > 0)
+        {
+            entry& e = pool[path[--depth]];
+            if (e.left == pool_type::null)
+            {
+                e.value = pool[e.right].value;
+            }
+            else if (e.right == pool_type::null)
+            {
+                e.value = pool[e.left].value;
+            }
+            else
+            {
+                segment_tree_detail::merge_into(policy, e.value, pool[e.left].value, pool[e.right].value);
+            }
+        }
+    }
+
+    // Number of nodes created so far
+    size_t node_count() const
+    {
+        return pool.live_entries();
+    }
+
+    // Bytes held by this instance for the node pool,
+    // not counting memory owned by the nodes themselves
+    size_t memory_footprint() const
+    {
+        return sizeof(*this) + pool.memory_footprint();
+    }
+
+private:
+    struct entry
+    {
+        node value;
+        std::uint32_t left;
+        std::uint32_t right;
+    };
+
+    typedef segment_tree_detail::node_pool<entry> pool_type;
+    typedef typename pool_type::handle handle;
+
+    merge_policy policy;
+    index_type ar_size;
+    node identity;
+    handle root;
+    pool_type pool;
+
+    // A subtree a query still has to visit
+    struct pending
+    {
+        handle v;
+        index_type node_lo;
+        index_type node_hi;
+    };
+
+    // Answers queries [first, last) with up to query_lanes of them in
+    // flight. Every lane keeps its own stack of created subtrees that
+    // intersect its query, the left one on top so that nodes fold in array
+    // order. Each stack holds at most one pending subtree per level.
+    void range_query_lockstep( const std::vector<std::pair<index_type, index_type>>& queries, size_t first, size_t last,
+                               std::vector<node>& results )
+    {
+        const size_t width = segment_tree_detail::query_lanes;
+        const size_t depth = 66;
+        std::vector<pending> stacks(width * depth);
+        size_t query[width];
+        size_t top[width];
+        node solution[width];
+        node scratch = identity;
+        size_t lanes = 0;
+        size_t next = first;
+
+        // Gives lane k the next query, or returns false when none is left.
+        // Without a root every query is the identity and needs no lane.
+        auto start = [&]( size_t k )
+        {
+            if (next == last)
+            {
+                return false;
+            }
+            if (root == pool_type::null)
+            {
+                for (; next < last; next++)
+                {
+                    results[next] = identity;
+                }
+                return false;
+            }
+            query[k] = next++;
+            solution[k] = identity;
+            top[k] = 0;
+            push(&stacks[k * depth], top[k], root, 0, ar_size - 1);
+            return true;
+        };
+        while (lanes < width && start(lanes))
+        {
+            lanes++;
+        }
+
+        while (lanes > 0)
+        {
+            for (size_t k = 0; k < lanes; )
+            {
+                pending* stack = &stacks[k * depth];
+                pending current = stack[--top[k]];
+                index_type lo = queries[query[k]].first;
+                index_type hi = queries[query[k]].second;
+                entry& e = pool[current.v];
+                if (lo <= current.node_lo && hi >= current.node_hi)
+                {
+                    segment_tree_detail::merge_into(policy, scratch, solution[k], e.value);
+                    std::swap(solution[k], scratch);
+                }
+                else
+                {
+                    index_type mid = current.node_lo + (current.node_hi - current.node_lo) / 2;
+                    if (hi > mid)
+                    {
+                        push(stack, top[k], e.right, mid + 1, current.node_hi);
+                    }
+                    if (lo <= mid)
+                    {
+                        push(stack, top[k], e.left, current.node_lo, mid);
+                    }
+                }
+
+                if (top[k] > 0)
+                {
+                    k++;
+                    continue;
+                }
+                std::swap(results[query[k]], solution[k]);
+                if (start(k))
+                {
+                    k++;
+                    continue;
+                }
+
+                // The last lane moves into the finished one
+                lanes--;
+                query[k] = query[lanes];
+                top[k] = top[lanes];
+                std::swap(solution[k], solution[lanes]);
+                std::copy(stacks.begin() + lanes * depth, stacks.begin() + lanes * depth + top[k], stacks.begin() + k * depth);
+            }
+        }
+    }
+
+    // Pushes subtree v unless it was never created, and starts loading it
+    void push( pending* stack, size_t& top, handle v, index_type node_lo, index_type node_hi )
+    {
+        if (v == pool_type::null)
+        {
+            return;
+        }
+        pending& slot = stack[top++];
+        slot.v = v;
+        slot.node_lo = node_lo;
+        slot.node_hi = node_hi;
+        segment_tree_detail::prefetch(&pool[v]);
+    }
+
+    // Folds the fully contained nodes into solution from left to right,
+    // skipping subtrees that were never created
+    void range_query( handle v, index_type node_lo, index_type node_hi, index_type lo, index_type hi, node& solution, node& scratch )
+    {
+        // Interval doesn't intersect at all, or holds only identities
+        if (v == pool_type::null || lo > node_hi || hi < node_lo)
+        {
+            return;
+        }
+
+        // Interval completely contained
+        if (lo <= node_lo && hi >= node_hi)
+        {
+            segment_tree_detail::merge_into(policy, scratch, solution, pool[v].value);
+            std::swap(solution, scratch);
+            return;
+        }
+
+        // Interval partially intersects
+        index_type mid = node_lo + (node_hi - node_lo) / 2;
+        range_query(pool[v].left, node_lo, mid, lo, hi, solution, scratch);
+        range_query(pool[v].right, mid + 1, node_hi, lo, hi, solution, scratch);
+    }
+};
+
+template <  typename        T,
+            typename        node,
+            void            (*set_default_value)(node&, T),
+            node           (*merge)(node*, node*)    >
+using sparse_segment_tree = basic_sparse_segment_tree< T, node, function_merge_policy<T, node, set_default_value, merge> >;
+
+#endif
@@ -0,0 +1,185 @@
+#ifndef SPARSE_TABLE
+#define SPARSE_TABLE
+
+#include "segment_tree.hpp"
+
+#include <vector>
+#include <type_traits>
+
+// Specialize deriving from std::true_type for a node type whose merge is
+// idempotent, that is merge(a, a) == a, like minimum, maximum or gcd.
+// Overlapping partial results are then safe to merge.
+template < typename node >
+struct segment_tree_idempotent : std::false_type
+{
+};
+
+// Read-only table answering range queries with a single merge for
+// idempotent merges. Level k holds the merge of every window of 2^k
+// elements, and any interval is the union of two overlapping windows.
+// Takes O(N log N) nodes and the same merge policies as basic_segment_tree.
+template <  typename        T,
+            typename        node,
+            typename        merge_policy    >
+class basic_sparse_table
+{
+    static_assert(segment_tree_idempotent<node>::value,
+        "sparse tables need an idempotent merge, specialize segment_tree_idempotent for the node type "
+        "or use a disjoint sparse table");
+
+public:
+    basic_sparse_table( const std::vector<T>& init_ar, const merge_policy& policy = merge_policy() )
+        : policy(policy)
+    {
+        construct_table(init_ar);
+    }
+
+    void construct_table( const std::vector<T>& init_ar )
+    {
+        ar_size = init_ar.size();
+        levels = ar_size == 0 ? 0 : segment_tree_detail::floor_log2(ar_size) + 1;
+        table.assign(levels * ar_size, node());
+        for (size_t i = 0; i < ar_size; i++)
+        {
+            policy.set_default_value(table[i], init_ar[i]);
+        }
+
+        // Windows of level k are two adjacent windows of level k - 1
+        for (size_t k = 1; k < levels; k++)
+        {
+            size_t half = (size_t)1 << (k - 1);
+            node* level = &table[k * ar_size];
+            node* previous = &table[(k - 1) * ar_size];
+            for (size_t i = 0; i + 2 * half <= ar_size; i++)
+            {
+                segment_tree_detail::merge_into(policy, level[i], previous[i], previous[i + half]);
+            }
+        }
+    }
+
+    size_t get_array_size()
+    {
+        return ar_size;
+    }
+
+    node range_query( int lo, int hi )
+    {
+        size_t k = segment_tree_detail::floor_log2(hi - lo + 1);
+        node* level = &table[k * ar_size];
+        node solution;
+        segment_tree_detail::merge_into(policy, solution, level[lo], level[hi + 1 - ((size_t)1 << k)]);
+        return solution;
+    }
+
+    // Bytes held by this instance for the node storage,
+    // not counting memory owned by the nodes themselves
+    size_t memory_footprint() const
+    {
+        return sizeof(*this) + table.capacity() * sizeof(node);
+    }
+
+private:
+    merge_policy policy;
+    size_t ar_size;
+    size_t levels;
+    std::vector<node> table;
+};
+
+// Read-only table answering range queries with a single merge for any
+// associative merge, commutative or not. Level h splits the array into
+// blocks of 2^h elements and stores, for every element, the merge from it
+// to the middle of its block. An interval whose ends first part ways at
+// level h is then the suffix of its left end merged with the prefix of its
+// right end. Takes O(N log N) nodes.
+template <  typename        T,
+            typename        node,
+            typename        merge_policy    >
+class basic_disjoint_sparse_table
+{
+public:
+    basic_disjoint_sparse_table( const std::vector<T>& init_ar, const merge_policy& policy = merge_policy() )
+        : policy(policy)
+    {
+        construct_table(init_ar);
+    }
+
+    void construct_table( const std::vector<T>& init_ar )
+    {
+        ar_size = init_ar.size();
+        levels = ar_size <= 1 ? 1 : segment_tree_detail::floor_log2(ar_size - 1) + 2;
+        table.assign(levels * ar_size, node());
+        node* leaves = &table[0];
+        for (size_t i = 0; i < ar_size; i++)
+        {
+            policy.set_default_value(leaves[i], init_ar[i]);
+        }
+
+        for (size_t h = 1; h < levels; h++)
+        {
+            size_t half = (size_t)1 << (h - 1);
+            node* level = &table[h * ar_size];
+            // Blocks whose right half is empty never answer a query
+            for (size_t mid = half; mid < ar_size; mid += 2 * half)
+            {
+                // Suffixes of the left half, built towards the left
+                level[mid - 1] = leaves[mid - 1];
+                for (size_t i = mid - 1; i > mid - half; i--)
+                {
+                    segment_tree_detail::merge_into(policy, level[i - 1], leaves[i - 1], level[i]);
+                }
+                // Prefixes of the right half, built towards the right
+                size_t end = std::min(mid + half, ar_size);
+                level[mid] = leaves[mid];
+                for (size_t i = mid + 1; i < end; i++)
+                {
+                    segment_tree_detail::merge_into(policy, level[i], level[i - 1], leaves[i]);
+                }
+            }
+        }
+    }
+
+    size_t get_array_size()
+    {
+        return ar_size;
+    }
+
+    node range_query( int lo, int hi )
+    {
+        if (lo == hi)
+        {
+            return table[lo];
+        }
+        size_t h = segment_tree_detail::floor_log2((size_t)(lo ^ hi)) + 1;
+        node* level = &table[h * ar_size];
+        node solution;
+        segment_tree_detail::merge_into(policy, solution, level[lo], level[hi]);
+        return solution;
+    }
+
+    // Bytes held by this instance for the node storage,
+    // not counting memory owned by the nodes themselves
+    size_t memory_footprint() const
+    {
+        return sizeof(*this) + table.capacity() * sizeof(node);
+    }
+
+private:
+    merge_policy policy;
+    size_t ar_size;
+    size_t levels;
+    std::vector<node> table;
+};
+
+template <  typename        T,
+            typename        node,
+            void            (*set_default_value)(node&, T),
+            node           (*merge)(node*, node*)    >
+using sparse_table = basic_sparse_table< T, node, function_merge_policy<T, node, set_default_value, merge> >;
+
+template <  typename        T,
+            typename        node,
+            void            (*set_default_value)(node&, T),
+            node           (*merge)(node*, node*)    >
+using disjoint_sparse_table = basic_disjoint_sparse_table< T, node, function_merge_policy<T, node, set_default_value, merge> >;
+
+#endif
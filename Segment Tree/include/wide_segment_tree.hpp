@@ -0,0 +1,422 @@
+#ifndef WIDE_SEGMENT_TREE
+#define WIDE_SEGMENT_TREE
+
+#include <vector>
+#include <limits>
+#include <algorithm>
+#include <type_traits>
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+// Reductions for wide_segment_tree. Each one provides the identity and
+// the combination of two values, both as static members. combine must be
+// commutative as well as associative: queries fold partial blocks from
+// both ends into one accumulator and vector lanes are combined in any
+// order.
+template < typename V >
+struct wide_sum
+{
+    static V identity()
+    {
+        return V(0);
+    }
+
+    static V combine( V a, V b )
+    {
+        return a + b;
+    }
+};
+
+template < typename V >
+struct wide_min
+{
+    static V identity()
+    {
+        return std::numeric_limits<V>::max();
+    }
+
+    static V combine( V a, V b )
+    {
+        return std::min(a, b);
+    }
+};
+
+template < typename V >
+struct wide_max
+{
+    static V identity()
+    {
+        return std::numeric_limits<V>::lowest();
+    }
+
+    static V combine( V a, V b )
+    {
+        return std::max(a, b);
+    }
+};
+
+namespace segment_tree_detail
+{
+    // Vector instructions for a reduction, specialized below where available
+    template < typename reduction >
+    struct wide_simd
+    {
+        static const bool enabled = false;
+    };
+
+#ifdef __AVX2__
+    // Eight 32-bit lanes per register
+    struct avx2_int_lanes
+    {
+        typedef __m256i vector;
+
+        static vector load( const int* p )
+        {
+            return _mm256_loadu_si256((const __m256i*)p);
+        }
+
+        static vector broadcast( int x )
+        {
+            return _mm256_set1_epi32(x);
+        }
+
+        // Lanes of data whose mask is set, identity elsewhere
+        static vector select( vector identity, vector data, __m256i mask )
+        {
+            return _mm256_blendv_epi8(identity, data, mask);
+        }
+
+        // Lane order rotated so that combining with the original halves
+        // the number of distinct partial results
+        static vector swap_halves( vector x )
+        {
+            return _mm256_permute2x128_si256(x, x, 1);
+        }
+
+        static vector swap_pairs( vector x )
+        {
+            return _mm256_shuffle_epi32(x, _MM_SHUFFLE(1, 0, 3, 2));
+        }
+
+        static vector swap_neighbours( vector x )
+        {
+            return _mm256_shuffle_epi32(x, _MM_SHUFFLE(2, 3, 0, 1));
+        }
+
+        static int first( vector x )
+        {
+            return _mm256_cvtsi256_si32(x);
+        }
+    };
+
+    struct avx2_float_lanes
+    {
+        typedef __m256 vector;
+
+        static vector load( const float* p )
+        {
+            return _mm256_loadu_ps(p);
+        }
+
+        static vector broadcast( float x )
+        {
+            return _mm256_set1_ps(x);
+        }
+
+        static vector select( vector identity, vector data, __m256i mask )
+        {
+            return _mm256_blendv_ps(identity, data, _mm256_castsi256_ps(mask));
+        }
+
+        static vector swap_halves( vector x )
+        {
+            return _mm256_permute2f128_ps(x, x, 1);
+        }
+
+        static vector swap_pairs( vector x )
+        {
+            return _mm256_permute_ps(x, _MM_SHUFFLE(1, 0, 3, 2));
+        }
+
+        static vector swap_neighbours( vector x )
+        {
+            return _mm256_permute_ps(x, _MM_SHUFFLE(2, 3, 0, 1));
+        }
+
+        static float first( vector x )
+        {
+            return _mm256_cvtss_f32(x);
+        }
+    };
+
+    template <>
+    struct wide_simd< wide_sum<int> > : avx2_int_lanes
+    {
+        static const bool enabled = true;
+
+        static vector combine( vector a, vector b )
+        {
+            return _mm256_add_epi32(a, b);
+        }
+    };
+
+    template <>
+    struct wide_simd< wide_min<int> > : avx2_int_lanes
+    {
+        static const bool enabled = true;
+
+        static vector combine( vector a, vector b )
+        {
+            return _mm256_min_epi32(a, b);
+        }
+    };
+
+    template <>
+    struct wide_simd< wide_max<int> > : avx2_int_lanes
+    {
+        static const bool enabled = true;
+
+        static vector combine( vector a, vector b )
+        {
+            return _mm256_max_epi32(a, b);
+        }
+    };
+
+    template <>
+    struct wide_simd< wide_sum<float> > : avx2_float_lanes
+    {
+        static const bool enabled = true;
+
+        static vector combine( vector a, vector b )
+        {
+            return _mm256_add_ps(a, b);
+        }
+    };
+
+    template <>
+    struct wide_simd< wide_min<float> > : avx2_float_lanes
+    {
+        static const bool enabled = true;
+
+        static vector combine( vector a, vector b )
+        {
+            return _mm256_min_ps(a, b);
+        }
+    };
+
+    template <>
+    struct wide_simd< wide_max<float> > : avx2_float_lanes
+    {
+        static const bool enabled = true;
+
+        static vector combine( vector a, vector b )
+        {
+            return _mm256_max_ps(a, b);
+        }
+    };
+
+    // Reduces the lanes [first, last) other than skip of a block of B values,
+    // eight at a time, with the remaining lanes replaced by the identity
+    template < typename V, typename reduction, size_t B >
+    V reduce_block( const V* block, size_t first, size_t last, size_t skip, std::true_type )
+    {
+        typedef wide_simd<reduction> simd;
+        typename simd::vector identity = simd::broadcast(reduction::identity());
+        typename simd::vector solution = identity;
+        __m256i lane = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+        __m256i lower = _mm256_set1_epi32((int)first - 1);
+        __m256i upper = _mm256_set1_epi32((int)last);
+        __m256i skipped = _mm256_set1_epi32((int)skip);
+        for (size_t i = 0; i < B; i += 8)
+        {
+            __m256i mask = _mm256_and_si256(_mm256_cmpgt_epi32(lane, lower), _mm256_cmpgt_epi32(upper, lane));
+            mask = _mm256_andnot_si256(_mm256_cmpeq_epi32(lane, skipped), mask);
+            solution = simd::combine(solution, simd::select(identity, simd::load(block + i), mask));
+            lane = _mm256_add_epi32(lane, _mm256_set1_epi32(8));
+        }
+        solution = simd::combine(solution, simd::swap_halves(solution));
+        solution = simd::combine(solution, simd::swap_pairs(solution));
+        solution = simd::combine(solution, simd::swap_neighbours(solution));
+        return simd::first(solution);
+    }
+#endif
+
+    template < typename V, typename reduction, size_t B >
+    V reduce_block( const V* block, size_t first, size_t last, size_t skip, std::false_type )
+    {
+        V result = reduction::identity();
+        size_t split = std::min(std::max(skip, first), last);
+        for (size_t i = first; i < split; i++)
+        {
+            result = reduction::combine(result, block[i]);
+        }
+        for (size_t i = split == skip ? split + 1 : split; i < last; i++)
+        {
+            result = reduction::combine(result, block[i]);
+        }
+        return result;
+    }
+
+    template < typename reduction, size_t B >
+    struct wide_vectorized : std::integral_constant<bool, wide_simd<reduction>::enabled && B % 8 == 0>
+    {
+    };
+
+    // Reduces the values [first, last) of a block of B values, leaving out
+    // the one at skip if it is in range
+    template < typename V, typename reduction, size_t B >
+    V reduce_block( const V* block, size_t first, size_t last, size_t skip = B )
+    {
+        return reduce_block<V, reduction, B>(block, first, last, skip, wide_vectorized<reduction, B>());
+    }
+}
+
+// Static B-ary segment tree over arithmetic values. Every level is an
+// array padded with the identity to a multiple of B, and the B children
+// of a node are contiguous in the level below, so a node is recomputed
+// and a partial block is reduced with a few vector instructions. Queries
+// climb log_B N levels and reduce at most two partial blocks per level.
+// reduction is wide_sum, wide_min, wide_max or any commutative reduction
+// with the same static members. AVX2 builds vectorize int and float reductions when B
+// is a multiple of 8, everything else takes the scalar loop.
+template <  typename        V,
+            typename        reduction = wide_sum<V>,
+            size_t          B = 16    >
+class wide_segment_tree
+{
+    static_assert(B >= 2, "nodes need at least two children");
+
+public:
+    wide_segment_tree( size_t N )
+    {
+        construct_tree(std::vector<V>(N, reduction::identity()));
+    }
+
+    wide_segment_tree( const std::vector<V>& init_ar )
+    {
+        construct_tree(init_ar);
+    }
+
+    void construct_tree( const std::vector<V>& init_ar )
+    {
+        ar_size = init_ar.size();
+
+        // level_start[k] is the first value of level k, the leaves being level 0
+        level_start.assign(1, 0);
+        size_t count = std::max<size_t>(ar_size, 1);
+        while (true)
+        {
+            count = (count + B - 1) / B * B;
+            level_start.push_back(level_start.back() + count);
+            if (count == B)
+            {
+                break;
+            }
+            count /= B;
+        }
+
+        tree.assign(level_start.back(), reduction::identity());
+        std::copy(init_ar.begin(), init_ar.end(), tree.begin());
+        for (size_t k = 0; k + 2 < level_start.size(); k++)
+        {
+            size_t blocks = (level_start[k + 1] - level_start[k]) / B;
+            for (size_t b = 0; b < blocks; b++)
+            {
+                tree[level_start[k + 1] + b] = segment_tree_detail::reduce_block<V, reduction, B>(&tree[level_start[k] + b * B], 0, B);
+            }
+        }
+    }
+
+    size_t get_array_size()
+    {
+        return ar_size;
+    }
+
+    V range_query( int lo, int hi )
+    {
+        V solution = reduction::identity();
+        size_t l = lo;
+        size_t r = hi;
+        for (size_t k = 0; ; k++)
+        {
+            const V* level = &tree[level_start[k]];
+            size_t l_block = l / B;
+            size_t r_block = r / B;
+            if (l_block == r_block)
+            {
+                return reduction::combine(solution, segment_tree_detail::reduce_block<V, reduction, B>(level + l_block * B, l % B, r % B + 1));
+            }
+
+            // Whole blocks at either end are left to their parents. The
+            // right end is folded in before the blocks between, which is
+            // only correct for commutative reductions.
+            size_t next_l = l_block;
+            size_t next_r = r_block;
+            if (l % B != 0)
+            {
+                solution = reduction::combine(solution, segment_tree_detail::reduce_block<V, reduction, B>(level + l_block * B, l % B, B));
+                next_l++;
+            }
+            if (r % B != B - 1)
+            {
+                solution = reduction::combine(solution, segment_tree_detail::reduce_block<V, reduction, B>(level + r_block * B, 0, r % B + 1));
+                next_r--;
+            }
+            if (next_l > next_r)
+            {
+                return solution;
+            }
+            l = next_l;
+            r = next_r;
+        }
+    }
+
+    void point_update( int index, V new_value )
+    {
+        point_update(index, new_value, segment_tree_detail::wide_vectorized<reduction, B>());
+    }
+
+    // Bytes held by this instance for the levels
+    size_t memory_footprint() const
+    {
+        return sizeof(*this) + tree.capacity() * sizeof(V) + level_start.capacity() * sizeof(size_t);
+    }
+
+private:
+    size_t ar_size;
+    std::vector<size_t> level_start;
+    std::vector<V> tree;
+
+    // Each parent is the new child combined with its untouched siblings,
+    // read before the child is written, so that vector loads never wait on
+    // a scalar store to the block they read
+    void point_update( int index, V new_value, std::true_type )
+    {
+        size_t i = index;
+        V value = new_value;
+        for (size_t k = 0; k + 2 < level_start.size(); k++)
+        {
+            size_t block = i / B;
+            V siblings = segment_tree_detail::reduce_block<V, reduction, B>(&tree[level_start[k] + block * B], 0, B, i % B);
+            tree[level_start[k] + i] = value;
+            value = reduction::combine(siblings, value);
+            i = block;
+        }
+        tree[level_start[level_start.size() - 2] + i] = value;
+    }
+
+    void point_update( int index, V new_value, std::false_type )
+    {
+        size_t i = index;
+        tree[i] = new_value;
+        for (size_t k = 0; k + 2 < level_start.size(); k++)
+        {
+            size_t block = i / B;
+            tree[level_start[k + 1] + block] = segment_tree_detail::reduce_block<V, reduction, B>(&tree[level_start[k] + block * B], 0, B);
+            i = block;
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,316 @@
+#include "pch.h"
+#include "segment_tree.hpp"
+#include "atomic_segment_tree.hpp"
+
+#include <vector>
+#include <random>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include <iostream>
+#include <limits>
+
+namespace atomic_query
+{
+    // Structures and methods for the mutex-wrapped tree the atomic
+    // tree is measured against
+    struct node
+    {
+        long long sum;
+    };
+
+    void set_default_value( node& x, long long y )
+    {
+        x.sum = y;
+    }
+
+    node merge( node* a, node* b )
+    {
+        node ans;
+        ans.sum = a->sum + b->sum;
+        return ans;
+    }
+
+    typedef segment_tree< long long, node, set_default_value, merge > sum_tree;
+
+    class locked_sum_tree
+    {
+    public:
+        locked_sum_tree( size_t N )
+            : tree(std::vector<long long>(N, 0))
+        {
+        }
+
+        long long range_query( int lo, int hi )
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            return tree.range_query(lo, hi).sum;
+        }
+
+        void add( int index, long long delta )
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            tree.point_update(index, tree.get_array()[index] + delta);
+        }
+
+    private:
+        sum_tree tree;
+        std::mutex mutex;
+    };
+
+    // Interleaves additions, replacements and queries at random positions,
+    // comparing against a plain array
+    template < typename V >
+    void check_sequential( size_t n, size_t m )
+    {
+        std::vector<V> brute_force(n);
+        std::random_device rd;
+        std::mt19937 gen(rd());
+        std::uniform_int_distribution<> index_dis(0, n - 1);
+        std::uniform_int_distribution<> value_dis(-1000, 1000);
+        for (size_t i = 0; i < n; i++)
+        {
+            brute_force[i] = V(value_dis(gen));
+        }
+        atomic_segment_tree<V> segtree(brute_force);
+        EXPECT_EQ(n, segtree.get_array_size());
+
+        for (size_t i = 0; i < m; i++)
+        {
+            int index = index_dis(gen);
+            V value = V(value_dis(gen));
+            if (i % 2 == 0)
+            {
+                segtree.add(index, value);
+                brute_force[index] += value;
+            }
+            else
+            {
+                segtree.point_update(index, value);
+                brute_force[index] = value;
+            }
+
+            int lo = index_dis(gen);
+            int hi = std::uniform_int_distribution<>(lo, n - 1)(gen);
+            V expected = V(0);
+            for (int j = lo; j <= hi; j++)
+            {
+                expected += brute_force[j];
+            }
+            EXPECT_EQ(expected, segtree.range_query(lo, hi));
+        }
+    }
+
+
+    // Tests for range_query(), add() and point_update() on one thread
+
+    TEST( atomic_segment_tree, sequential_use )
+    {
+        check_sequential<int>(1, 10);
+        check_sequential<int>(1000, 2000);
+        check_sequential<long long>(777, 2000);
+        // Small whole numbers add up exactly in a double
+        check_sequential<double>(999, 2000);
+    }
+
+    TEST( atomic_segment_tree, starts_at_zero )
+    {
+        atomic_segment_tree<long long> segtree(100);
+        EXPECT_EQ(0, segtree.range_query(0, 99));
+        segtree.add(42, 5);
+        EXPECT_EQ(5, segtree.range_query(0, 99));
+        EXPECT_EQ(0, segtree.range_query(43, 99));
+        EXPECT_GE(segtree.memory_footprint(), 200 * sizeof(long long));
+    }
+
+
+    TEST( atomic_segment_tree, integer_sums_wrap_around )
+    {
+        std::vector<int> parameter_array(4, std::numeric_limits<int>::max());
+        atomic_segment_tree<int> segtree(parameter_array);
+        EXPECT_EQ(-4, segtree.range_query(0, 3));
+        EXPECT_EQ(-2, segtree.range_query(1, 2));
+        segtree.point_update(0, std::numeric_limits<int>::min());
+        EXPECT_EQ(-1, segtree.range_query(0, 1));
+        segtree.add(3, 1);
+        EXPECT_EQ(std::numeric_limits<int>::min(), segtree.range_query(3, 3));
+    }
+
+
+    // Tests for updates and queries from many threads at once
+
+    TEST( atomic_segment_tree, concurrent_additions_are_not_lost )
+    {
+        size_t n = 1000;
+        unsigned threads = 8;
+        size_t m = 20000;
+        atomic_segment_tree<long long> segtree(n);
+        std::vector<std::vector<long long>> added(threads, std::vector<long long>(n, 0));
+
+        std::vector<std::thread> workers;
+        for (unsigned t = 0; t < threads; t++)
+        {
+            workers.push_back(std::thread([&, t]()
+            {
+                std::mt19937 gen(t);
+                std::uniform_int_distribution<> index_dis(0, n - 1);
+                std::uniform_int_distribution<> value_dis(-1000, 1000);
+                for (size_t i = 0; i < m; i++)
+                {
+                    int index = index_dis(gen);
+                    int delta = value_dis(gen);
+                    segtree.add(index, delta);
+                    added[t][index] += delta;
+                }
+            }));
+        }
+        for (size_t i = 0; i < workers.size(); i++)
+        {
+            workers[i].join();
+        }
+
+        long long prefix = 0;
+        for (size_t i = 0; i < n; i++)
+        {
+            long long element = 0;
+            for (unsigned t = 0; t < threads; t++)
+            {
+                element += added[t][i];
+            }
+            prefix += element;
+            EXPECT_EQ(element, segtree.range_query(i, i));
+            EXPECT_EQ(prefix, segtree.range_query(0, i));
+        }
+    }
+
+    TEST( atomic_segment_tree, concurrent_replacements_of_one_element )
+    {
+        atomic_segment_tree<long long> segtree(64);
+        std::vector<std::thread> workers;
+        for (unsigned t = 0; t < 8; t++)
+        {
+            workers.push_back(std::thread([&, t]()
+            {
+                for (int i = 0; i < 20000; i++)
+                {
+                    segtree.point_update(17, t * 100000 + i);
+                }
+            }));
+        }
+        for (size_t i = 0; i < workers.size(); i++)
+        {
+            workers[i].join();
+        }
+
+        // Whichever replacement came last, the ancestors agree with the leaf
+        long long last = segtree.range_query(17, 17);
+        EXPECT_EQ(19999, last % 100000);
+        EXPECT_EQ(last, segtree.range_query(0, 63));
+        EXPECT_EQ(last, segtree.range_query(10, 20));
+    }
+
+    TEST( atomic_segment_tree, queries_count_whole_updates )
+    {
+        // Each position lies in exactly one of the nodes a query reads, and
+        // one thread's loads of a node never go back to an older value, so
+        // with writers only adding, a reader sees the range grow in steps
+        // of whole updates even though it may count any subset of them
+        size_t n = 3000;
+        int lo = 123;
+        int hi = 2345;
+        atomic_segment_tree<long long> segtree(n);
+        std::atomic<bool> stop(false);
+        std::atomic<size_t> shrunk(0);
+        std::atomic<size_t> reads(0);
+
+        std::vector<std::thread> threads;
+        for (unsigned r = 0; r < 4; r++)
+        {
+            threads.push_back(std::thread([&]()
+            {
+                long long last = 0;
+                size_t count = 0;
+                while (!stop.load())
+                {
+                    long long seen = segtree.range_query(lo, hi);
+                    if (seen < last || seen % 1000 != 0)
+                    {
+                        shrunk++;
+                    }
+                    last = seen;
+                    count++;
+                }
+                reads += count;
+            }));
+        }
+        for (unsigned w = 0; w < 4; w++)
+        {
+            threads.push_back(std::thread([&, w]()
+            {
+                std::mt19937 gen(w);
+                std::uniform_int_distribution<> index_dis(0, n - 1);
+                while (!stop.load())
+                {
+                    segtree.add(index_dis(gen), 1000);
+                }
+            }));
+        }
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        stop.store(true);
+        for (size_t i = 0; i < threads.size(); i++)
+        {
+            threads[i].join();
+        }
+        EXPECT_EQ(0u, shrunk.load());
+        EXPECT_GT(reads.load(), 0u);
+    }
+
+
+    // Additions per second from 1 to 64 threads, against a mutex around a
+    // single tree. A benchmark that prints rather than checks, so it only
+    // runs with --gtest_also_run_disabled_tests.
+    template < typename tree_type >
+    double additions_per_second( tree_type& tree, size_t n, unsigned threads, size_t per_thread )
+    {
+        std::vector<std::thread> workers;
+        auto start = std::chrono::steady_clock::now();
+        for (unsigned t = 0; t < threads; t++)
+        {
+            workers.push_back(std::thread([&, t]()
+            {
+                std::mt19937 gen(t);
+                std::uniform_int_distribution<> index_dis(0, n - 1);
+                for (size_t i = 0; i < per_thread; i++)
+                {
+                    tree.add(index_dis(gen), 1);
+                }
+            }));
+        }
+        for (size_t i = 0; i < workers.size(); i++)
+        {
+            workers[i].join();
+        }
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        EXPECT_EQ((long long)(threads * per_thread), tree.range_query(0, n - 1));
+        return threads * per_thread / elapsed.count();
+    }
+
+    TEST( atomic_segment_tree, DISABLED_throughput_by_thread_count )
+    {
+        size_t n = 1 << 16;
+        size_t per_thread = 20000;
+        for (unsigned threads = 1; threads <= 64; threads *= 2)
+        {
+            locked_sum_tree locked(n);
+            double locked_rate = additions_per_second(locked, n, threads, per_thread);
+
+            atomic_segment_tree<long long> atomic(n);
+            double atomic_rate = additions_per_second(atomic, n, threads, per_thread);
+
+            std::cout << threads << " threads: mutex " << (size_t)locked_rate << " additions/s, atomic "
+                      << (size_t)atomic_rate << " additions/s" << std::endl;
+        }
+    }
+}
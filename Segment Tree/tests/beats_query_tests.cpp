@@ -0,0 +1,230 @@
+#include "pch.h"
+#include "segment_tree_beats.hpp"
+
+#include <vector>
+#include <utility>
+#include <random>
+#include <algorithm>
+#include <cmath>
+
+namespace beats_query
+{
+    // Structures and methods for testing segment tree beats
+    typedef beats_node<long long> node;
+
+    // Counts the nodes a range update touches
+    struct counting_clamp_policy : range_clamp_policy<long long>
+    {
+        size_t* applications;
+
+        counting_clamp_policy( size_t* applications )
+            : applications(applications)
+        {
+        }
+
+        void apply( node& x, const tag_type& f, size_t length ) const
+        {
+            (*applications)++;
+            range_clamp_policy<long long>::apply(x, f, length);
+        }
+    };
+
+    // Generates an array of n random integers ranging from 1 to n
+    void fill_with_random_integers( size_t n, std::vector<long long>& parameter_array )
+    {
+        std::random_device rd;
+        std::mt19937 gen(rd());
+        std::uniform_int_distribution<> dis(1, n);
+        for (int i = 0; i < (int)n; i++)
+        {
+            parameter_array.push_back(dis(gen));
+        }
+    }
+
+    // Generates m random interval queries
+    void fill_with_random_intervals( size_t n, size_t m, std::vector<std::pair<int, int>>& queries )
+    {
+        std::random_device rd;
+        std::mt19937 gen(rd());
+        std::uniform_int_distribution<> dis1(0, n - 1);
+        for (int i = 0; i < (int)m; i++)
+        {
+            // Generate the lower bound of the interval
+            int x = dis1(gen);
+            // Make a uniform distribution within [x, n]
+            std::uniform_int_distribution<> dis2(x, n - 1);
+            // Generate the upper bound of the interval
+            int y = dis2(gen);
+            queries.push_back({x, y});
+        }
+    }
+
+    // Brute force check of the sum, minimum and maximum of an interval
+    void expect_brute_force( const std::vector<long long>& ar, segment_tree_beats<long long, counting_clamp_policy>& segtree, int lo, int hi )
+    {
+        long long sum = 0;
+        long long min = ar[lo];
+        long long max = ar[lo];
+        for (int i = lo; i <= hi; i++)
+        {
+            sum += ar[i];
+            min = std::min(min, ar[i]);
+            max = std::max(max, ar[i]);
+        }
+        node actual = segtree.range_query(lo, hi);
+        EXPECT_EQ(sum, actual.sum);
+        EXPECT_EQ(min, actual.min);
+        EXPECT_EQ(max, actual.max);
+    }
+
+    // Interleaves random chmin, chmax and point updates with range queries
+    void check_against_brute_force( size_t n, size_t m )
+    {
+        std::vector<long long> parameter_array;
+        fill_with_random_integers(n, parameter_array);
+
+        size_t applications = 0;
+        segment_tree_beats<long long, counting_clamp_policy> segtree(parameter_array, counting_clamp_policy(&applications));
+
+        std::vector<std::pair<int, int>> updates;
+        fill_with_random_intervals(n, m, updates);
+        std::vector<std::pair<int, int>> queries;
+        fill_with_random_intervals(n, m, queries);
+
+        std::random_device rd;
+        std::mt19937 gen(rd());
+        std::uniform_int_distribution<> dis(1, n);
+
+        for (int i = 0; i < (int)m; i++)
+        {
+            long long value = dis(gen);
+            if (i % 3 == 0)
+            {
+                segtree.range_chmin(updates[i].first, updates[i].second, value);
+                for (int j = updates[i].first; j <= updates[i].second; j++)
+                {
+                    parameter_array[j] = std::min(parameter_array[j], value);
+                }
+            }
+            else if (i % 3 == 1)
+            {
+                segtree.range_chmax(updates[i].first, updates[i].second, value);
+                for (int j = updates[i].first; j <= updates[i].second; j++)
+                {
+                    parameter_array[j] = std::max(parameter_array[j], value);
+                }
+            }
+            else
+            {
+                segtree.point_update(updates[i].first, value);
+                parameter_array[updates[i].first] = value;
+            }
+            expect_brute_force(parameter_array, segtree, queries[i].first, queries[i].second);
+        }
+    }
+
+
+    // Tests for range_chmin() and range_chmax()
+
+    TEST( segment_tree_beats_clamp, vector_parameter_case1 )
+    {
+        check_against_brute_force(1, 10);
+    }
+
+    TEST( segment_tree_beats_clamp, vector_parameter_case2 )
+    {
+        check_against_brute_force(42, 420);
+    }
+
+    TEST( segment_tree_beats_clamp, vector_parameter_case3 )
+    {
+        check_against_brute_force(4200, 4200);
+    }
+
+
+    // Stress tests for the amortized bound. Every update is applied to the whole
+    // array, so without beats each of them would touch all n leaves
+
+    TEST( segment_tree_beats_amortized, alternating_clamps_on_distinct_values )
+    {
+        size_t n = 1 << 16;
+        size_t m = 1 << 16;
+        std::vector<long long> parameter_array(n);
+        for (int i = 0; i < (int)n; i++)
+        {
+            parameter_array[i] = i;
+        }
+
+        size_t applications = 0;
+        segment_tree_beats<long long, counting_clamp_policy> segtree(parameter_array, counting_clamp_policy(&applications));
+
+        // Squeeze the values one step at a time from both ends
+        for (int i = 0; i < (int)m / 2; i++)
+        {
+            segtree.range_chmin(0, (int)n - 1, (long long)n - 1 - i);
+            segtree.range_chmax(0, (int)n - 1, (long long)i);
+        }
+
+        double log_n = std::log2((double)n);
+        EXPECT_LT((double)applications, 4.0 * (double)(n + m) * log_n * log_n);
+
+        for (int i = 0; i < (int)n; i++)
+        {
+            parameter_array[i] = std::min(std::max(parameter_array[i], (long long)m / 2 - 1), (long long)(n - m / 2));
+        }
+        expect_brute_force(parameter_array, segtree, 0, (int)n - 1);
+        expect_brute_force(parameter_array, segtree, 42, (int)n / 2);
+    }
+
+    TEST( segment_tree_beats_amortized, point_updates_restore_distinct_values )
+    {
+        size_t n = 1 << 14;
+        size_t m = 1 << 14;
+        std::vector<long long> parameter_array(n);
+        for (int i = 0; i < (int)n; i++)
+        {
+            parameter_array[i] = i;
+        }
+
+        size_t applications = 0;
+        segment_tree_beats<long long, counting_clamp_policy> segtree(parameter_array, counting_clamp_policy(&applications));
+
+        std::random_device rd;
+        std::mt19937 gen(rd());
+        std::uniform_int_distribution<> index_dis(0, (int)n - 1);
+        std::uniform_int_distribution<> value_dis(0, (int)n - 1);
+
+        // Point updates spread fresh values that later clamps have to cut down again
+        for (int i = 0; i < (int)m; i++)
+        {
+            for (int j = 0; j < 4; j++)
+            {
+                int index = index_dis(gen);
+                long long value = value_dis(gen);
+                segtree.point_update(index, value);
+                parameter_array[index] = value;
+            }
+            long long value = value_dis(gen);
+            if (i % 2 == 0)
+            {
+                segtree.range_chmin(0, (int)n - 1, value);
+                for (int j = 0; j < (int)n; j++)
+                {
+                    parameter_array[j] = std::min(parameter_array[j], value);
+                }
+            }
+            else
+            {
+                segtree.range_chmax(0, (int)n - 1, value);
+                for (int j = 0; j < (int)n; j++)
+                {
+                    parameter_array[j] = std::max(parameter_array[j], value);
+                }
+            }
+        }
+
+        double log_n = std::log2((double)n);
+        EXPECT_LT((double)applications, 4.0 * (double)(n + 5 * m) * log_n * log_n);
+        expect_brute_force(parameter_array, segtree, 0, (int)n - 1);
+    }
+}
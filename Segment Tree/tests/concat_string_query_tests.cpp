@@ -0,0 +1,262 @@
+#include "pch.h"
+#include "segment_tree.hpp"
+#include "segment_tree_bucketed.hpp"
+
+#include <string>
+#include <vector>
+#include <utility>
+#include <random>
+
+namespace concat_string_query
+{
+    // Structures and methods for testing the segment tree with
+    // a non-commutative merge, the concatenation of the characters
+    // in an interval
+    struct node
+    {
+        std::string text;
+    };
+
+    void set_default_value( node& x, char y )
+    {
+        x.text = std::string(1, y);
+    }
+
+    node merge( node* a, node* b )
+    {
+        node ans;
+        ans.text = a->text + b->text;
+        return ans;
+    }
+
+    // The same merge on a node type without an identity, whose queries
+    // combine boost::optional partial results instead
+    struct plain_node
+    {
+        std::string text;
+    };
+
+    void set_default_value( plain_node& x, char y )
+    {
+        x.text = std::string(1, y);
+    }
+
+    plain_node merge( plain_node* a, plain_node* b )
+    {
+        plain_node ans;
+        ans.text = a->text + b->text;
+        return ans;
+    }
+}
+
+// The empty string is the identity of concatenation
+template <>
+struct segment_tree_identity<concat_string_query::node>
+{
+    static concat_string_query::node value()
+    {
+        return concat_string_query::node();
+    }
+};
+
+namespace concat_string_query
+{
+    // Generates an array of n random lowercase letters
+    void fill_with_random_characters( size_t n, std::vector<char>& parameter_array )
+    {
+        std::random_device rd;
+        std::mt19937 gen(rd());
+        std::uniform_int_distribution<> dis(97, 122);
+        for (int i = 0; i < (int)n; i++)
+        {
+            parameter_array.push_back((char)dis(gen));
+        }
+    }
+
+    // Generates m random interval queries
+    void fill_with_random_intervals( size_t n, size_t m, std::vector<std::pair<int, int>>& queries )
+    {
+        std::random_device rd;
+        std::mt19937 gen(rd());
+        std::uniform_int_distribution<> dis1(0, n - 1);
+        for (int i = 0; i < (int)m; i++)
+        {
+            // Generate the lower bound of the interval
+            int x = dis1(gen);
+            // Make a uniform distribution within [x, n]
+            std::uniform_int_distribution<> dis2(x, n - 1);
+            // Generate the upper bound of the interval
+            int y = dis2(gen);
+            queries.push_back({x, y});
+        }
+    }
+
+    // Brute force method to solve the concatenation of interval problem
+    void run_brute_force( const std::vector<char>& ar,
+                          const std::vector<std::pair<int, int>>& queries,
+                          std::vector<std::string>& results )
+    {
+        size_t m = queries.size();
+        for (int i = 0; i < (int)m; i++)
+        {
+            results[i] = std::string(ar.begin() + queries[i].first, ar.begin() + queries[i].second + 1);
+        }
+    }
+
+    template < typename backend, typename tree_node = node >
+    void check_range_queries( size_t n, size_t m, unsigned threads = 1 )
+    {
+        std::vector<char> parameter_array;
+        fill_with_random_characters(n, parameter_array);
+
+        segment_tree< char, tree_node, set_default_value, merge, backend > segtree(n);
+        segtree.construct_tree(parameter_array, threads);
+
+        std::vector<std::pair<int, int>> queries;
+        fill_with_random_intervals(n, m, queries);
+
+        std::vector<std::string> segment_tree_results(m);
+        for (int i = 0; i < (int)m; i++)
+        {
+            segment_tree_results[i] = (segtree.range_query(queries[i].first, queries[i].second)).text;
+        }
+
+        std::vector<std::string> brute_force_results(m);
+        run_brute_force(parameter_array, queries, brute_force_results);
+
+        for (int i = 0; i < (int)m; i++)
+        {
+            EXPECT_EQ(brute_force_results[i], segment_tree_results[i]);
+        }
+    }
+
+    template < typename backend, typename tree_node = node >
+    void check_point_updates( size_t n, size_t m )
+    {
+        std::vector<char> parameter_array;
+        fill_with_random_characters(n, parameter_array);
+
+        segment_tree< char, tree_node, set_default_value, merge, backend > segtree(parameter_array);
+
+        for (int index = 0; index < (int)n; index += 7)
+        {
+            parameter_array[index] = 'A';
+            segtree.point_update(index, 'A');
+        }
+
+        std::vector<std::pair<int, int>> queries;
+        fill_with_random_intervals(n, m, queries);
+
+        std::vector<std::string> segment_tree_results(m);
+        for (int i = 0; i < (int)m; i++)
+        {
+            segment_tree_results[i] = (segtree.range_query(queries[i].first, queries[i].second)).text;
+        }
+
+        std::vector<std::string> brute_force_results(m);
+        run_brute_force(parameter_array, queries, brute_force_results);
+
+        for (int i = 0; i < (int)m; i++)
+        {
+            EXPECT_EQ(brute_force_results[i], segment_tree_results[i]);
+        }
+    }
+
+
+    // Tests for range_query() on every backend
+
+    TEST( concat_string_segment_tree_rquery, iterative_backend )
+    {
+        check_range_queries<segment_tree_backend::iterative>(1, 1);
+        check_range_queries<segment_tree_backend::iterative>(42, 420);
+        check_range_queries<segment_tree_backend::iterative>(4201, 4200);
+    }
+
+    TEST( concat_string_segment_tree_rquery, recursive_backend )
+    {
+        check_range_queries<segment_tree_backend::recursive>(1, 1);
+        check_range_queries<segment_tree_backend::recursive>(42, 420);
+        check_range_queries<segment_tree_backend::recursive>(4201, 4200);
+    }
+
+    TEST( concat_string_segment_tree_rquery, compact_backend )
+    {
+        check_range_queries<segment_tree_backend::compact>(1, 1);
+        check_range_queries<segment_tree_backend::compact>(42, 420);
+        check_range_queries<segment_tree_backend::compact>(4201, 4200);
+        check_range_queries<segment_tree_backend::compact>(4096, 420);
+        check_range_queries<segment_tree_backend::compact>(42001, 420, 4);
+    }
+
+    TEST( concat_string_segment_tree_rquery, bucketed_backend )
+    {
+        check_range_queries< segment_tree_backend::bucketed<> >(1, 1);
+        check_range_queries< segment_tree_backend::bucketed<> >(42, 420);
+        check_range_queries< segment_tree_backend::bucketed<> >(4201, 4200);
+        check_range_queries< segment_tree_backend::bucketed<1> >(4201, 420);
+        check_range_queries< segment_tree_backend::bucketed<4> >(4096, 420);
+        check_range_queries< segment_tree_backend::bucketed<64> >(4097, 420);
+        check_range_queries< segment_tree_backend::bucketed<> >(42001, 420, 4);
+    }
+
+
+    // Tests for construct_tree() building subtrees on several threads. The
+    // merge is not commutative, so misplaced subtrees show up in the results
+
+    TEST( concat_string_segment_tree_parallel_construct, iterative_backend )
+    {
+        check_range_queries<segment_tree_backend::iterative>(42, 420, 4);
+        check_range_queries<segment_tree_backend::iterative>(42001, 420, 4);
+        check_range_queries<segment_tree_backend::iterative>(65536, 420, 3);
+    }
+
+    TEST( concat_string_segment_tree_parallel_construct, recursive_backend )
+    {
+        check_range_queries<segment_tree_backend::recursive>(42, 420, 4);
+        check_range_queries<segment_tree_backend::recursive>(42001, 420, 4);
+        check_range_queries<segment_tree_backend::recursive>(65536, 420, 3);
+    }
+
+
+    // Tests for point_update() on every backend
+
+    TEST( concat_string_segment_tree_pupdate, iterative_backend )
+    {
+        check_point_updates<segment_tree_backend::iterative>(1337, 420);
+    }
+
+    TEST( concat_string_segment_tree_pupdate, recursive_backend )
+    {
+        check_point_updates<segment_tree_backend::recursive>(1337, 420);
+    }
+
+    TEST( concat_string_segment_tree_pupdate, compact_backend )
+    {
+        check_point_updates<segment_tree_backend::compact>(1337, 420);
+    }
+
+    TEST( concat_string_segment_tree_pupdate, bucketed_backend )
+    {
+        check_point_updates< segment_tree_backend::bucketed<> >(1337, 420);
+        check_point_updates< segment_tree_backend::bucketed<4> >(1337, 420);
+    }
+
+
+    // Tests for range_query() and point_update() without an identity
+
+    TEST( concat_string_segment_tree_no_identity, iterative_backend )
+    {
+        check_range_queries<segment_tree_backend::iterative, plain_node>(1, 1);
+        check_range_queries<segment_tree_backend::iterative, plain_node>(42, 420);
+        check_range_queries<segment_tree_backend::iterative, plain_node>(4201, 4200);
+        check_point_updates<segment_tree_backend::iterative, plain_node>(1337, 420);
+    }
+
+    TEST( concat_string_segment_tree_no_identity, recursive_backend )
+    {
+        check_range_queries<segment_tree_backend::recursive, plain_node>(1, 1);
+        check_range_queries<segment_tree_backend::recursive, plain_node>(42, 420);
+        check_range_queries<segment_tree_backend::recursive, plain_node>(4201, 4200);
+        check_point_updates<segment_tree_backend::recursive, plain_node>(1337, 420);
+    }
+}
@@ -0,0 +1,201 @@
+#include "pch.h"
+#include "segment_tree.hpp"
+#include "concurrent_segment_tree.hpp"
+
+#include <vector>
+#include <utility>
+#include <random>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include <iostream>
+
+namespace concurrent_query
+{
+    // Structures and methods for testing the concurrent segment tree
+    // with the sum of an interval
+    struct node
+    {
+        long long sum;
+    };
+
+    void set_default_value( node& x, int y )
+    {
+        x.sum = y;
+    }
+
+    node merge( node* a, node* b )
+    {
+        node ans;
+        ans.sum = a->sum + b->sum;
+        return ans;
+    }
+
+    typedef segment_tree< int, node, set_default_value, merge > sum_tree;
+    typedef segment_tree< int, node, set_default_value, merge, segment_tree_backend::iterative, int, false > sum_nodes_tree;
+
+    // Takes a mutex around every query and update, the baseline
+    // the concurrent tree is measured against
+    class locked_sum_tree
+    {
+    public:
+        locked_sum_tree( const std::vector<int>& init_ar )
+            : tree(init_ar)
+        {
+        }
+
+        node range_query( int lo, int hi )
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            return tree.range_query(lo, hi);
+        }
+
+        void point_update_batch( const std::vector<std::pair<int, int>>& updates )
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            tree.point_update_batch(updates);
+        }
+
+    private:
+        sum_tree tree;
+        std::mutex mutex;
+    };
+
+    // Runs readers and writers on shared_tree for the given time. Every
+    // write moves one unit from one element to another as a single batch,
+    // so the total never changes, and every read of the whole array
+    // checks that it sees no half-done write. Returns the reads and the
+    // writes completed.
+    template < typename tree_type >
+    std::pair<size_t, size_t> run_readers_and_writers( tree_type& shared_tree, size_t n, long long total,
+                                                        unsigned readers, unsigned writers, std::chrono::milliseconds duration )
+    {
+        std::atomic<bool> stop(false);
+        std::atomic<size_t> reads(0);
+        std::atomic<size_t> writes(0);
+        std::atomic<size_t> torn(0);
+        std::mutex writer_state;
+        std::vector<int> values(n, (int)(total / n));
+
+        std::vector<std::thread> threads;
+        for (unsigned r = 0; r < readers; r++)
+        {
+            threads.push_back(std::thread([&, r]()
+            {
+                std::mt19937 gen(r);
+                std::uniform_int_distribution<> dis(0, n - 1);
+                size_t count = 0;
+                while (!stop.load())
+                {
+                    if (shared_tree.range_query(0, (int)n - 1).sum != total)
+                    {
+                        torn++;
+                    }
+                    int lo = dis(gen);
+                    shared_tree.range_query(lo, std::uniform_int_distribution<>(lo, n - 1)(gen));
+                    count += 2;
+                }
+                reads += count;
+            }));
+        }
+        for (unsigned w = 0; w < writers; w++)
+        {
+            threads.push_back(std::thread([&, w]()
+            {
+                std::mt19937 gen(1000 + w);
+                std::uniform_int_distribution<> dis(0, n - 1);
+                size_t count = 0;
+                while (!stop.load())
+                {
+                    std::vector<std::pair<int, int>> updates;
+                    {
+                        std::lock_guard<std::mutex> lock(writer_state);
+                        int from = dis(gen);
+                        int to = dis(gen);
+                        if (from == to || values[from] == 0)
+                        {
+                            continue;
+                        }
+                        values[from]--;
+                        values[to]++;
+                        updates.push_back({from, values[from]});
+                        updates.push_back({to, values[to]});
+                        shared_tree.point_update_batch(updates);
+                    }
+                    count++;
+                }
+                writes += count;
+            }));
+        }
+
+        std::this_thread::sleep_for(duration);
+        stop.store(true);
+        for (size_t i = 0; i < threads.size(); i++)
+        {
+            threads[i].join();
+        }
+        EXPECT_EQ(0u, torn.load());
+        return std::make_pair(reads.load(), writes.load());
+    }
+
+
+    // Tests for read() and write()
+
+    TEST( concurrent_segment_tree, sequential_use )
+    {
+        std::vector<int> parameter_array(1000, 1);
+        concurrent_segment_tree<sum_tree> segtree(parameter_array);
+        EXPECT_EQ(1000, segtree.range_query(0, 999).sum);
+
+        segtree.point_update(10, 5);
+        segtree.point_update(999, 3);
+        EXPECT_EQ(1006, segtree.range_query(0, 999).sum);
+        EXPECT_EQ(5, segtree.range_query(10, 10).sum);
+
+        // Both instances carry every write
+        segtree.point_update(0, 0);
+        EXPECT_EQ(1005, segtree.range_query(0, 999).sum);
+        segtree.point_update(1, 0);
+        EXPECT_EQ(1004, segtree.range_query(0, 999).sum);
+        EXPECT_EQ(3, segtree.read([]( sum_tree& tree ) { return tree.get_array()[999]; }));
+    }
+
+    TEST( concurrent_segment_tree, readers_see_whole_writes )
+    {
+        size_t n = 4096;
+        long long total = 100 * (long long)n;
+        std::vector<int> parameter_array(n, 100);
+        concurrent_segment_tree<sum_nodes_tree> segtree(parameter_array);
+        std::pair<size_t, size_t> counts = run_readers_and_writers(segtree, n, total, 4, 2, std::chrono::milliseconds(200));
+        EXPECT_GT(counts.first, 0u);
+        EXPECT_GT(counts.second, 0u);
+        EXPECT_EQ(total, segtree.range_query(0, (int)n - 1).sum);
+    }
+
+
+    // Throughput against a mutex around a single tree, sweeping the number
+    // of readers per writer. A benchmark that prints rather than checks, so
+    // it only runs with --gtest_also_run_disabled_tests.
+    TEST( concurrent_segment_tree, DISABLED_throughput_by_reader_writer_ratio )
+    {
+        size_t n = 1 << 16;
+        long long total = 100 * (long long)n;
+        std::vector<int> parameter_array(n, 100);
+        std::chrono::milliseconds duration(100);
+        unsigned ratios[] = { 1, 4, 16 };
+        for (size_t i = 0; i < sizeof(ratios) / sizeof(ratios[0]); i++)
+        {
+            locked_sum_tree locked(parameter_array);
+            std::pair<size_t, size_t> locked_counts = run_readers_and_writers(locked, n, total, ratios[i], 1, duration);
+
+            concurrent_segment_tree<sum_nodes_tree> concurrent(parameter_array);
+            std::pair<size_t, size_t> concurrent_counts = run_readers_and_writers(concurrent, n, total, ratios[i], 1, duration);
+
+            size_t per_second = 1000 / (size_t)duration.count();
+            std::cout << ratios[i] << " readers per writer: mutex " << locked_counts.first * per_second << " reads/s, "
+                      << locked_counts.second * per_second << " writes/s; left-right " << concurrent_counts.first * per_second
+                      << " reads/s, " << concurrent_counts.second * per_second << " writes/s" << std::endl;
+        }
+    }
+}
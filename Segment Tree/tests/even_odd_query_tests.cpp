@@ -1,5 +1,6 @@
 #include "pch.h"
 #include "segment_tree.hpp"
+#include "segment_tree_fenwick.hpp"
 
 #include <vector>
 #include <utility>
@@ -28,7 +29,35 @@ namespace even_odd_query
         ans.even = a->even + b->even;
         return ans;
     }
-    
+}
+
+// Empty intervals count nothing, and counts are undone by their negation
+template <>
+struct segment_tree_identity<even_odd_query::node>
+{
+    static even_odd_query::node value()
+    {
+        even_odd_query::node identity;
+        identity.odd = 0;
+        identity.even = 0;
+        return identity;
+    }
+};
+
+template <>
+struct segment_tree_inverse<even_odd_query::node>
+{
+    static even_odd_query::node value( const even_odd_query::node& x )
+    {
+        even_odd_query::node inverse;
+        inverse.odd = -x.odd;
+        inverse.even = -x.even;
+        return inverse;
+    }
+};
+
+namespace even_odd_query
+{
     // Generates an array of n random integers ranging from 1 to n
     void fill_with_random_integers( size_t n, std::vector<int>& parameter_array )
     {
@@ -346,4 +375,35 @@ namespace even_odd_query
             }
         }
     }
+
+
+    // Test for range_query() and point_update() on the Fenwick backend
+    TEST( even_odd_segment_tree_fenwick, vector_parameter_case )
+    {
+        size_t n = 4200;
+        std::vector<int> parameter_array;
+        fill_with_random_integers(n, parameter_array);
+
+        segment_tree< int, node, set_default_value, merge, segment_tree_backend::fenwick > segtree(parameter_array);
+
+        for (int index = 0; index < (int)n; index += 7)
+        {
+            parameter_array[index] = 42;
+            segtree.point_update(index, 42);
+        }
+
+        size_t m = 420;
+        std::vector<std::pair<int, int>> queries;
+        fill_with_random_intervals(n, m, queries);
+
+        std::vector<node> brute_force_results(m);
+        run_brute_force(parameter_array, queries, brute_force_results);
+
+        for (int i = 0; i < (int)m; i++)
+        {
+            node actual = segtree.range_query(queries[i].first, queries[i].second);
+            EXPECT_EQ(brute_force_results[i].odd, actual.odd);
+            EXPECT_EQ(brute_force_results[i].even, actual.even);
+        }
+    }
 }
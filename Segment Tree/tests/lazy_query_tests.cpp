@@ -0,0 +1,340 @@
+#include "pch.h"
+#include "lazy_segment_tree.hpp"
+
+#include <vector>
+#include <utility>
+#include <random>
+#include <algorithm>
+
+namespace lazy_range_query
+{
+    // Structures and methods for testing the lazy segment tree
+    // with the ready-made lazy policies
+    typedef range_aggregate<long long> node;
+
+    // Generates an array of n random integers ranging from 1 to n
+    void fill_with_random_integers( size_t n, std::vector<long long>& parameter_array )
+    {
+        std::random_device rd;
+        std::mt19937 gen(rd());
+        std::uniform_int_distribution<> dis(1, n);
+        for (int i = 0; i < (int)n; i++)
+        {
+            parameter_array.push_back(dis(gen));
+        }
+    }
+
+    // Generates m random interval queries
+    void fill_with_random_intervals( size_t n, size_t m, std::vector<std::pair<int, int>>& queries )
+    {
+        std::random_device rd;
+        std::mt19937 gen(rd());
+        std::uniform_int_distribution<> dis1(0, n - 1);
+        for (int i = 0; i < (int)m; i++)
+        {
+            // Generate the lower bound of the interval
+            int x = dis1(gen);
+            // Make a uniform distribution within [x, n]
+            std::uniform_int_distribution<> dis2(x, n - 1);
+            // Generate the upper bound of the interval
+            int y = dis2(gen);
+            queries.push_back({x, y});
+        }
+    }
+
+    // Brute force method to aggregate an interval
+    node run_brute_force( const std::vector<long long>& ar, int lo, int hi )
+    {
+        node ans;
+        ans.sum = 0;
+        ans.min = ar[lo];
+        ans.max = ar[lo];
+        for (int i = lo; i <= hi; i++)
+        {
+            ans.sum += ar[i];
+            ans.min = std::min(ans.min, ar[i]);
+            ans.max = std::max(ans.max, ar[i]);
+        }
+        return ans;
+    }
+
+    // Interleaves random range updates with range queries and point
+    // updates, checking every query against the brute force method
+    template < typename lazy_policy, typename brute_force_update >
+    void check_against_brute_force( size_t n, size_t m, brute_force_update update )
+    {
+        std::vector<long long> parameter_array;
+        fill_with_random_integers(n, parameter_array);
+
+        lazy_segment_tree< long long, node, lazy_policy > segtree(parameter_array);
+
+        std::vector<std::pair<int, int>> updates;
+        fill_with_random_intervals(n, m, updates);
+        std::vector<std::pair<int, int>> queries;
+        fill_with_random_intervals(n, m, queries);
+
+        std::random_device rd;
+        std::mt19937 gen(rd());
+        std::uniform_int_distribution<> dis(-(int)n, (int)n);
+
+        for (int i = 0; i < (int)m; i++)
+        {
+            long long tag = dis(gen);
+            segtree.range_update(updates[i].first, updates[i].second, tag);
+            for (int j = updates[i].first; j <= updates[i].second; j++)
+            {
+                update(parameter_array[j], tag);
+            }
+
+            if (i % 10 == 0)
+            {
+                long long value = dis(gen);
+                segtree.point_update(queries[i].first, value);
+                parameter_array[queries[i].first] = value;
+            }
+
+            node expected = run_brute_force(parameter_array, queries[i].first, queries[i].second);
+            node actual = segtree.range_query(queries[i].first, queries[i].second);
+            EXPECT_EQ(expected.sum, actual.sum);
+            EXPECT_EQ(expected.min, actual.min);
+            EXPECT_EQ(expected.max, actual.max);
+        }
+    }
+
+    void add( long long& x, long long delta )
+    {
+        x += delta;
+    }
+
+    void assign( long long& x, long long value )
+    {
+        x = value;
+    }
+
+
+    // Tests for range_update() with range_add_policy
+
+    TEST( lazy_segment_tree_range_add, vector_parameter_case1 )
+    {
+        check_against_brute_force< range_add_policy<long long> >(1, 10, add);
+    }
+
+    TEST( lazy_segment_tree_range_add, vector_parameter_case2 )
+    {
+        check_against_brute_force< range_add_policy<long long> >(42, 420, add);
+    }
+
+    TEST( lazy_segment_tree_range_add, vector_parameter_case3 )
+    {
+        check_against_brute_force< range_add_policy<long long> >(4200, 4200, add);
+    }
+
+
+    // Tests for range_update() with range_assign_policy
+
+    TEST( lazy_segment_tree_range_assign, vector_parameter_case1 )
+    {
+        check_against_brute_force< range_assign_policy<long long> >(1, 10, assign);
+    }
+
+    TEST( lazy_segment_tree_range_assign, vector_parameter_case2 )
+    {
+        check_against_brute_force< range_assign_policy<long long> >(42, 420, assign);
+    }
+
+    TEST( lazy_segment_tree_range_assign, vector_parameter_case3 )
+    {
+        check_against_brute_force< range_assign_policy<long long> >(4200, 4200, assign);
+    }
+
+
+    // Tests for range_update() with range_affine_policy
+
+    void check_affine_against_brute_force( size_t n, size_t m )
+    {
+        std::vector<long long> parameter_array;
+        fill_with_random_integers(n, parameter_array);
+
+        lazy_segment_tree< long long, node, range_affine_policy<long long> > segtree(parameter_array);
+
+        std::vector<std::pair<int, int>> updates;
+        fill_with_random_intervals(n, m, updates);
+        std::vector<std::pair<int, int>> queries;
+        fill_with_random_intervals(n, m, queries);
+
+        // Factors in [-1, 1] keep the values from overflowing
+        std::random_device rd;
+        std::mt19937 gen(rd());
+        std::uniform_int_distribution<> mul_dis(-1, 1);
+        std::uniform_int_distribution<> add_dis(-(int)n, (int)n);
+
+        for (int i = 0; i < (int)m; i++)
+        {
+            affine_map<long long> f;
+            f.mul = mul_dis(gen);
+            f.add = add_dis(gen);
+            segtree.range_update(updates[i].first, updates[i].second, f);
+            for (int j = updates[i].first; j <= updates[i].second; j++)
+            {
+                parameter_array[j] = f.mul * parameter_array[j] + f.add;
+            }
+
+            node expected = run_brute_force(parameter_array, queries[i].first, queries[i].second);
+            node actual = segtree.range_query(queries[i].first, queries[i].second);
+            EXPECT_EQ(expected.sum, actual.sum);
+            EXPECT_EQ(expected.min, actual.min);
+            EXPECT_EQ(expected.max, actual.max);
+        }
+    }
+
+    TEST( lazy_segment_tree_range_affine, vector_parameter_case1 )
+    {
+        check_affine_against_brute_force(1, 10);
+    }
+
+    TEST( lazy_segment_tree_range_affine, vector_parameter_case2 )
+    {
+        check_affine_against_brute_force(42, 420);
+    }
+
+    TEST( lazy_segment_tree_range_affine, vector_parameter_case3 )
+    {
+        check_affine_against_brute_force(4200, 4200);
+    }
+
+
+    // Test for range_update() with modular_range_affine_policy
+    TEST( lazy_segment_tree_range_affine, modular_case )
+    {
+        size_t n = 4200;
+        size_t m = 4200;
+        long long modulus = 998244353;
+        std::vector<long long> parameter_array;
+        fill_with_random_integers(n, parameter_array);
+
+        modular_range_affine_policy<long long> policy(modulus);
+        lazy_segment_tree< long long, modular_range_sum<long long>, modular_range_affine_policy<long long> > segtree(parameter_array, policy);
+
+        std::vector<std::pair<int, int>> updates;
+        fill_with_random_intervals(n, m, updates);
+        std::vector<std::pair<int, int>> queries;
+        fill_with_random_intervals(n, m, queries);
+
+        std::random_device rd;
+        std::mt19937 gen(rd());
+        std::uniform_int_distribution<long long> dis(0, modulus - 1);
+
+        for (int i = 0; i < (int)m; i++)
+        {
+            affine_map<long long> f;
+            f.mul = dis(gen);
+            f.add = dis(gen);
+            segtree.range_update(updates[i].first, updates[i].second, f);
+            for (int j = updates[i].first; j <= updates[i].second; j++)
+            {
+                parameter_array[j] = (f.mul * parameter_array[j] % modulus + f.add) % modulus;
+            }
+
+            long long expected = 0;
+            for (int j = queries[i].first; j <= queries[i].second; j++)
+            {
+                expected = (expected + parameter_array[j]) % modulus;
+            }
+            EXPECT_EQ(expected, (segtree.range_query(queries[i].first, queries[i].second)).sum);
+        }
+    }
+
+    TEST( lazy_segment_tree_range_affine, modular_unreduced_tags )
+    {
+        size_t n = 420;
+        size_t m = 4200;
+        long long modulus = 998244353;
+        auto reduce = [&]( long long x )
+        {
+            x %= modulus;
+            return x < 0 ? x + modulus : x;
+        };
+        std::vector<long long> parameter_array;
+        fill_with_random_integers(n, parameter_array);
+        for (size_t i = 0; i < n; i++)
+        {
+            parameter_array[i] = reduce(parameter_array[i]);
+        }
+
+        modular_range_affine_policy<long long> policy(modulus);
+        lazy_segment_tree< long long, modular_range_sum<long long>, modular_range_affine_policy<long long> > segtree(parameter_array, policy);
+
+        std::vector<std::pair<int, int>> updates;
+        fill_with_random_intervals(n, m, updates);
+        std::vector<std::pair<int, int>> queries;
+        fill_with_random_intervals(n, m, queries);
+
+        // Negative coefficients and ones far past the modulus, which would
+        // overflow a product with a sum unless reduced first
+        std::random_device rd;
+        std::mt19937 gen(rd());
+        std::uniform_int_distribution<long long> dis(-(1LL << 62), 1LL << 62);
+
+        for (int i = 0; i < (int)m; i++)
+        {
+            affine_map<long long> f;
+            f.mul = dis(gen);
+            f.add = dis(gen);
+            segtree.range_update(updates[i].first, updates[i].second, f);
+            for (int j = updates[i].first; j <= updates[i].second; j++)
+            {
+                parameter_array[j] = (reduce(f.mul) * parameter_array[j] % modulus + reduce(f.add)) % modulus;
+            }
+
+            long long expected = 0;
+            for (int j = queries[i].first; j <= queries[i].second; j++)
+            {
+                expected = (expected + parameter_array[j]) % modulus;
+            }
+            long long actual = segtree.range_query(queries[i].first, queries[i].second).sum;
+            EXPECT_EQ(expected, actual);
+        }
+    }
+
+    TEST( lazy_segment_tree_range_affine, modular_unsigned_values )
+    {
+        size_t n = 420;
+        size_t m = 4200;
+        unsigned long long modulus = 998244353;
+        std::vector<unsigned long long> parameter_array(n);
+        std::random_device rd;
+        std::mt19937 gen(rd());
+        std::uniform_int_distribution<unsigned long long> dis(0, ~0ULL);
+        for (size_t i = 0; i < n; i++)
+        {
+            parameter_array[i] = dis(gen) % modulus;
+        }
+
+        modular_range_affine_policy<unsigned long long> policy(modulus);
+        lazy_segment_tree< unsigned long long, modular_range_sum<unsigned long long>, modular_range_affine_policy<unsigned long long> > segtree(parameter_array, policy);
+
+        std::vector<std::pair<int, int>> updates;
+        fill_with_random_intervals(n, m, updates);
+        std::vector<std::pair<int, int>> queries;
+        fill_with_random_intervals(n, m, queries);
+
+        for (int i = 0; i < (int)m; i++)
+        {
+            affine_map<unsigned long long> f;
+            f.mul = dis(gen);
+            f.add = dis(gen);
+            segtree.range_update(updates[i].first, updates[i].second, f);
+            for (int j = updates[i].first; j <= updates[i].second; j++)
+            {
+                parameter_array[j] = (f.mul % modulus * parameter_array[j] % modulus + f.add % modulus) % modulus;
+            }
+
+            unsigned long long expected = 0;
+            for (int j = queries[i].first; j <= queries[i].second; j++)
+            {
+                expected = (expected + parameter_array[j]) % modulus;
+            }
+            EXPECT_EQ(expected, segtree.range_query(queries[i].first, queries[i].second).sum);
+        }
+    }
+}
@@ -5,6 +5,8 @@
 #include <vector>
 #include <utility>
 #include <random>
+#include <memory>
+#include <algorithm>
 
 namespace max_string_query
 {
@@ -28,7 +30,20 @@ namespace max_string_query
         }
         return *b;
     }
-    
+}
+
+// The empty string precedes every string, so it is the identity of the max merge
+template <>
+struct segment_tree_identity<max_string_query::node>
+{
+    static max_string_query::node value()
+    {
+        return max_string_query::node();
+    }
+};
+
+namespace max_string_query
+{
     // Generates an array of n random strings composed of lowercase letters
     // Each string is arbitrarily defined to be 6 characters long
     void fill_with_random_strings( size_t n, std::vector<std::string>& parameter_array )
@@ -177,6 +192,101 @@ namespace max_string_query
         }
     }
 
+    // Counts the heap allocations made through counting_allocator
+    size_t allocation_count = 0;
+
+    template < typename U >
+    struct counting_allocator
+    {
+        typedef U value_type;
+
+        counting_allocator()
+        {
+        }
+
+        template < typename V >
+        counting_allocator( const counting_allocator<V>& )
+        {
+        }
+
+        U* allocate( size_t n )
+        {
+            allocation_count++;
+            return std::allocator<U>().allocate(n);
+        }
+
+        void deallocate( U* p, size_t n )
+        {
+            std::allocator<U>().deallocate(p, n);
+        }
+    };
+
+    template < typename U, typename V >
+    bool operator==( const counting_allocator<U>&, const counting_allocator<V>& )
+    {
+        return true;
+    }
+
+    template < typename U, typename V >
+    bool operator!=( const counting_allocator<U>&, const counting_allocator<V>& )
+    {
+        return false;
+    }
+
+    typedef std::basic_string< char, std::char_traits<char>, counting_allocator<char> > counted_string;
+
+    // Same query as node, but merged in place so that the
+    // storage already held by the parent node is reused
+    struct inplace_node
+    {
+        counted_string max;
+    };
+
+    struct inplace_max_policy
+    {
+        void set_default_value( inplace_node& x, const counted_string& y ) const
+        {
+            x.max = y;
+        }
+
+        void merge( inplace_node& out, const inplace_node& a, const inplace_node& b ) const
+        {
+            out.max = (a.max >= b.max) ? a.max : b.max;
+        }
+    };
+
+    // Same merge, with leaves that take over the values given to
+    // point_update and count how often they do
+    size_t move_count = 0;
+
+    struct moving_max_policy : inplace_max_policy
+    {
+        using inplace_max_policy::set_default_value;
+
+        void set_default_value( inplace_node& x, counted_string&& y ) const
+        {
+            x.max = std::move(y);
+            move_count++;
+        }
+    };
+
+    // Generates n random strings of the given length too long for the small string buffer
+    void fill_with_random_long_strings( size_t n, size_t length, std::vector<counted_string>& parameter_array )
+    {
+        std::random_device rd;
+        std::mt19937 gen(rd());
+        std::uniform_int_distribution<> dis(97, 122);
+        for (int i = 0; i < (int)n; i++)
+        {
+            counted_string s;
+            for (int j = 0; j < (int)length; j++)
+            {
+                s += (char)dis(gen);
+            }
+            parameter_array.push_back(s);
+        }
+    }
+
 
     // Tests for both types of constructors
 
@@ -415,4 +525,83 @@ namespace max_string_query
             }
         }
     }
+
+
+    // Test for in-place merges
+    TEST( max_string_segment_tree_inplace, no_steady_state_allocations )
+    {
+        size_t n = 4200;
+        size_t length = 42;
+        std::vector<counted_string> parameter_array;
+        fill_with_random_long_strings(n, length, parameter_array);
+
+        basic_segment_tree< counted_string, inplace_node, inplace_max_policy > segtree(parameter_array);
+
+        // Rebuilding a tree of the same shape reuses every node's storage
+        std::vector<counted_string> rebuild_array;
+        fill_with_random_long_strings(n, length, rebuild_array);
+        allocation_count = 0;
+        segtree.construct_tree(rebuild_array);
+        EXPECT_EQ(allocation_count, 0u);
+
+        // Updated values are moved into the array, copied into the leaf and
+        // merged into ancestors that already hold strings of the same length
+        std::vector<counted_string> new_values;
+        fill_with_random_long_strings(n, length, new_values);
+        allocation_count = 0;
+        for (int index = 0; index < (int)n; index++)
+        {
+            rebuild_array[index] = new_values[index];
+            segtree.point_update(index, std::move(new_values[index]));
+        }
+        EXPECT_EQ(allocation_count, 0u);
+
+        size_t m = 420;
+        std::vector<std::pair<int, int>> queries;
+        fill_with_random_intervals(n, m, queries);
+        for (int i = 0; i < (int)m; i++)
+        {
+            counted_string max = rebuild_array[queries[i].first];
+            for (int j = queries[i].first; j <= queries[i].second; j++)
+            {
+                if (rebuild_array[j] > max)
+                {
+                    max = rebuild_array[j];
+                }
+            }
+            EXPECT_EQ(max, (segtree.range_query(queries[i].first, queries[i].second)).max);
+        }
+    }
+
+    // Without an array to keep, each updated value ends up in its leaf
+    // through the policy's rvalue overload
+    template < typename backend >
+    void check_moved_updates( size_t n )
+    {
+        size_t length = 42;
+        std::vector<counted_string> parameter_array;
+        fill_with_random_long_strings(n, length, parameter_array);
+        basic_segment_tree< counted_string, inplace_node, moving_max_policy, backend, int, false > segtree(parameter_array);
+
+        std::vector<counted_string> new_values;
+        fill_with_random_long_strings(n, length, new_values);
+        std::vector<counted_string> expected = new_values;
+        move_count = 0;
+        allocation_count = 0;
+        for (int index = 0; index < (int)n; index++)
+        {
+            segtree.point_update(index, std::move(new_values[index]));
+        }
+        EXPECT_EQ(n, move_count);
+        EXPECT_EQ(0u, allocation_count);
+        EXPECT_EQ(*std::max_element(expected.begin(), expected.end()), segtree.range_query(0, n - 1).max);
+        EXPECT_EQ(expected[n / 2], segtree.range_query(n / 2, n / 2).max);
+    }
+
+    TEST( max_string_segment_tree_inplace, updates_move_into_leaves )
+    {
+        check_moved_updates<segment_tree_backend::iterative>(4200);
+        check_moved_updates<segment_tree_backend::recursive>(4200);
+        check_moved_updates<segment_tree_backend::compact>(4200);
+    }
 }
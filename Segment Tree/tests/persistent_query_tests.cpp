@@ -0,0 +1,275 @@
+#include "pch.h"
+#include "persistent_segment_tree.hpp"
+
+#include <vector>
+#include <utility>
+#include <random>
+#include <string>
+#include <stdexcept>
+
+namespace persistent_query
+{
+    // Sums, and concatenations that show a path copied with its
+    // children swapped
+    struct sum_node
+    {
+        long long sum;
+    };
+
+    void set_default_value( sum_node& x, int y )
+    {
+        x.sum = y;
+    }
+
+    sum_node merge( sum_node* a, sum_node* b )
+    {
+        sum_node result;
+        result.sum = a->sum + b->sum;
+        return result;
+    }
+
+    struct concat_node
+    {
+        std::string text;
+    };
+
+    void set_default_value( concat_node& x, int y )
+    {
+        x.text = std::string(1, (char)('a' + y % 26));
+    }
+
+    concat_node merge( concat_node* a, concat_node* b )
+    {
+        concat_node result;
+        result.text = a->text + b->text;
+        return result;
+    }
+
+    typedef persistent_segment_tree< int, sum_node, set_default_value, merge > sum_tree;
+    typedef persistent_segment_tree< int, concat_node, set_default_value, merge > concat_tree;
+
+    // Generates an array of n random integers ranging from 1 to n
+    void fill_with_random_integers( size_t n, std::vector<int>& parameter_array )
+    {
+        std::random_device rd;
+        std::mt19937 gen(rd());
+        std::uniform_int_distribution<> dis(1, n);
+        for (int i = 0; i < (int)n; i++)
+        {
+            parameter_array.push_back(dis(gen));
+        }
+    }
+
+    long long brute_force( const std::vector<int>& ar, int lo, int hi, sum_node* )
+    {
+        long long sum = 0;
+        for (int j = lo; j <= hi; j++)
+        {
+            sum += ar[j];
+        }
+        return sum;
+    }
+
+    std::string brute_force( const std::vector<int>& ar, int lo, int hi, concat_node* )
+    {
+        std::string text;
+        for (int j = lo; j <= hi; j++)
+        {
+            text += (char)('a' + ar[j] % 26);
+        }
+        return text;
+    }
+
+    long long answer( const sum_node& x )
+    {
+        return x.sum;
+    }
+
+    std::string answer( const concat_node& x )
+    {
+        return x.text;
+    }
+
+    // Derives m versions, each from a random earlier one, keeping a copy
+    // of the array of every version, then queries random versions
+    template < typename tree_type, typename node >
+    void check_versions( size_t n, size_t m )
+    {
+        std::vector<int> parameter_array;
+        fill_with_random_integers(n, parameter_array);
+
+        tree_type segtree(parameter_array);
+        EXPECT_EQ(n, segtree.get_array_size());
+
+        std::vector<std::vector<int>> arrays(1, parameter_array);
+        std::random_device rd;
+        std::mt19937 gen(rd());
+        std::uniform_int_distribution<> index_dis(0, n - 1);
+        std::uniform_int_distribution<> value_dis(1, n);
+        for (int i = 0; i < (int)m; i++)
+        {
+            size_t base = std::uniform_int_distribution<size_t>(0, arrays.size() - 1)(gen);
+            int index = index_dis(gen);
+            int value = value_dis(gen);
+            size_t version = segtree.point_update(base, index, value);
+            EXPECT_EQ(arrays.size(), version);
+            arrays.push_back(arrays[base]);
+            arrays.back()[index] = value;
+        }
+
+        for (int i = 0; i < (int)m; i++)
+        {
+            size_t version = std::uniform_int_distribution<size_t>(0, arrays.size() - 1)(gen);
+            int lo = index_dis(gen);
+            int hi = std::uniform_int_distribution<>(lo, n - 1)(gen);
+            EXPECT_EQ(brute_force(arrays[version], lo, hi, (node*)nullptr),
+                      answer(segtree.range_query(version, lo, hi)));
+        }
+    }
+
+
+    // Tests for range_query() and point_update() across versions
+
+    TEST( persistent_segment_tree_sum, versions_case1 )
+    {
+        check_versions< sum_tree, sum_node >(1, 10);
+    }
+
+    TEST( persistent_segment_tree_sum, versions_case2 )
+    {
+        check_versions< sum_tree, sum_node >(42, 420);
+    }
+
+    TEST( persistent_segment_tree_sum, versions_case3 )
+    {
+        check_versions< sum_tree, sum_node >(4200, 4200);
+    }
+
+    TEST( persistent_segment_tree_concat, versions_case )
+    {
+        check_versions< concat_tree, concat_node >(1, 10);
+        check_versions< concat_tree, concat_node >(42, 420);
+        check_versions< concat_tree, concat_node >(1025, 420);
+    }
+
+
+    // Tests for the node counts and release_version()
+
+    TEST( persistent_segment_tree_sum, path_copying )
+    {
+        // 1024 leaves, so every update copies the 11 nodes of a path
+        std::vector<int> parameter_array(1024, 1);
+        sum_tree segtree(parameter_array);
+        EXPECT_EQ(2047u, segtree.live_node_count());
+
+        size_t version = 0;
+        for (int i = 0; i < 100; i++)
+        {
+            version = segtree.point_update(version, i, 2);
+        }
+        EXPECT_EQ(2047u + 100 * 11, segtree.live_node_count());
+        EXPECT_EQ(1124, segtree.range_query(version, 0, 1023).sum);
+        EXPECT_EQ(1024, segtree.range_query(0, 0, 1023).sum);
+    }
+
+    TEST( persistent_segment_tree_sum, release_version )
+    {
+        std::vector<int> parameter_array;
+        fill_with_random_integers(1000, parameter_array);
+        sum_tree segtree(parameter_array);
+        size_t initial_nodes = segtree.live_node_count();
+
+        // Two branches from version 0
+        size_t a = segtree.point_update(0, 10, 5);
+        size_t b = segtree.point_update(a, 900, 7);
+        size_t c = segtree.point_update(0, 500, 9);
+        EXPECT_EQ(4u, segtree.live_version_count());
+
+        // Releasing a frees its root, the rest of it is shared with b
+        size_t before = segtree.live_node_count();
+        segtree.release_version(a);
+        EXPECT_FALSE(segtree.is_live(a));
+        EXPECT_TRUE(segtree.is_live(b));
+        EXPECT_GT(before, segtree.live_node_count());
+
+        parameter_array[10] = 5;
+        parameter_array[900] = 7;
+        long long expected = 0;
+        for (int x : parameter_array)
+        {
+            expected += x;
+        }
+        EXPECT_EQ(expected, segtree.range_query(b, 0, 999).sum);
+
+        // With only c left, exactly one full tree remains
+        segtree.release_version(0);
+        segtree.release_version(b);
+        EXPECT_EQ(initial_nodes, segtree.live_node_count());
+        EXPECT_EQ(1u, segtree.live_version_count());
+        EXPECT_EQ(c, segtree.latest_version());
+
+        // Released nodes are reused before the pool grows
+        size_t footprint = segtree.memory_footprint();
+        size_t version = c;
+        for (int i = 0; i < 100; i++)
+        {
+            size_t next = segtree.point_update(version, i, i);
+            segtree.release_version(version);
+            version = next;
+        }
+        EXPECT_EQ(initial_nodes, segtree.live_node_count());
+        EXPECT_GE(footprint + 256 * sizeof(std::uint32_t), segtree.memory_footprint());
+
+        segtree.release_version(version);
+        EXPECT_EQ(0u, segtree.live_node_count());
+        EXPECT_EQ(0u, segtree.live_version_count());
+    }
+
+    TEST( persistent_segment_tree_sum, release_version_twice )
+    {
+        std::vector<int> parameter_array(100, 1);
+        sum_tree segtree(parameter_array);
+        size_t a = segtree.point_update(0, 10, 5);
+        size_t nodes = segtree.live_node_count();
+
+        segtree.release_version(a);
+        size_t released = segtree.live_node_count();
+        EXPECT_GT(nodes, released);
+
+        // Released and unknown versions are left alone
+        segtree.release_version(a);
+        segtree.release_version(42);
+        EXPECT_EQ(released, segtree.live_node_count());
+        EXPECT_EQ(1u, segtree.live_version_count());
+        EXPECT_EQ(100, segtree.range_query(0, 0, 99).sum);
+
+        // Nodes freed once are handed out once
+        size_t b = segtree.point_update(0, 20, 3);
+        size_t c = segtree.point_update(0, 30, 4);
+        EXPECT_EQ(102, segtree.range_query(b, 0, 99).sum);
+        EXPECT_EQ(103, segtree.range_query(c, 0, 99).sum);
+    }
+
+    TEST( persistent_segment_tree_sum, use_released_version )
+    {
+        std::vector<int> parameter_array(100, 1);
+        sum_tree segtree(parameter_array);
+        size_t a = segtree.point_update(0, 10, 5);
+        size_t b = segtree.point_update(a, 20, 7);
+        segtree.release_version(a);
+        size_t nodes = segtree.live_node_count();
+
+        EXPECT_THROW(segtree.range_query(a, 0, 99), std::out_of_range);
+        EXPECT_THROW(segtree.point_update(a, 30, 9), std::out_of_range);
+        EXPECT_THROW(segtree.range_query(42, 0, 99), std::out_of_range);
+        EXPECT_EQ(nodes, segtree.live_node_count());
+        EXPECT_EQ(2u, segtree.live_version_count());
+
+        // Versions built on the released one keep their nodes
+        EXPECT_EQ(110, segtree.range_query(b, 0, 99).sum);
+        segtree.release_version(0);
+        EXPECT_EQ(110, segtree.range_query(b, 0, 99).sum);
+        size_t c = segtree.point_update(b, 50, 2);
+        EXPECT_EQ(111, segtree.range_query(c, 0, 99).sum);
+    }
+}
@@ -0,0 +1,297 @@
+#include "pch.h"
+#include "segment_tree.hpp"
+#include "sharded_segment_tree.hpp"
+
+#include <vector>
+#include <string>
+#include <utility>
+#include <random>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include <iostream>
+
+namespace sharded_query
+{
+    // Sums for the concurrent tests, and concatenations that show shards
+    // joined out of order
+    struct sum_node
+    {
+        long long sum;
+    };
+
+    void set_default_value( sum_node& x, int y )
+    {
+        x.sum = y;
+    }
+
+    sum_node merge( sum_node* a, sum_node* b )
+    {
+        sum_node result;
+        result.sum = a->sum + b->sum;
+        return result;
+    }
+
+    struct concat_node
+    {
+        std::string text;
+    };
+
+    void set_default_value( concat_node& x, char y )
+    {
+        x.text = std::string(1, y);
+    }
+
+    concat_node merge( concat_node* a, concat_node* b )
+    {
+        concat_node result;
+        result.text = a->text + b->text;
+        return result;
+    }
+
+    typedef sharded_segment_tree< int, sum_node, set_default_value, merge > sum_tree;
+    typedef sharded_segment_tree< char, concat_node, set_default_value, merge > concat_tree;
+    typedef segment_tree< int, sum_node, set_default_value, merge > single_sum_tree;
+
+    // Interleaves point updates, batches and queries at random positions,
+    // comparing against a plain string
+    void check_concat( size_t n, size_t shards, size_t m )
+    {
+        std::random_device rd;
+        std::mt19937 gen(rd());
+        std::uniform_int_distribution<> index_dis(0, n - 1);
+        std::uniform_int_distribution<> char_dis('a', 'z');
+        std::string brute_force;
+        for (size_t i = 0; i < n; i++)
+        {
+            brute_force += (char)char_dis(gen);
+        }
+        concat_tree segtree(std::vector<char>(brute_force.begin(), brute_force.end()), shards, function_merge_policy<char, concat_node, set_default_value, merge>(), 2);
+        EXPECT_EQ(n, segtree.get_array_size());
+        EXPECT_EQ(std::min(n, std::max<size_t>(shards, 1)), segtree.shard_count());
+
+        for (size_t i = 0; i < m; i++)
+        {
+            if (i % 4 == 0)
+            {
+                std::vector<std::pair<int, char>> updates;
+                for (int k = 0; k < 10; k++)
+                {
+                    updates.push_back(std::make_pair(index_dis(gen), (char)char_dis(gen)));
+                    brute_force[updates.back().first] = updates.back().second;
+                }
+                segtree.point_update_batch(updates);
+            }
+            else
+            {
+                int index = index_dis(gen);
+                char value = (char)char_dis(gen);
+                segtree.point_update(index, value);
+                brute_force[index] = value;
+            }
+
+            int lo = index_dis(gen);
+            int hi = std::uniform_int_distribution<>(lo, n - 1)(gen);
+            EXPECT_EQ(brute_force.substr(lo, hi - lo + 1), segtree.range_query(lo, hi).text);
+        }
+        EXPECT_EQ(brute_force, segtree.range_query(0, n - 1).text);
+    }
+
+
+    // Tests for range_query(), point_update() and point_update_batch()
+
+    TEST( sharded_segment_tree, matches_brute_force )
+    {
+        check_concat(1, 1, 10);
+        check_concat(100, 1, 300);
+        check_concat(100, 3, 300);
+        check_concat(1000, 7, 1000);
+        check_concat(1000, 64, 1000);
+        check_concat(50, 50, 300);
+    }
+
+    TEST( sharded_segment_tree, batch_repeats_keep_the_last_value )
+    {
+        sum_tree segtree(std::vector<int>(100, 1), 8);
+        std::vector<std::pair<int, int>> updates;
+        updates.push_back(std::make_pair(5, 10));
+        updates.push_back(std::make_pair(90, 20));
+        updates.push_back(std::make_pair(5, 30));
+        segtree.point_update_batch(updates);
+        EXPECT_EQ(30, segtree.range_query(5, 5).sum);
+        EXPECT_EQ(148, segtree.range_query(0, 99).sum);
+        EXPECT_GT(segtree.memory_footprint(), 100 * sizeof(int));
+    }
+
+    TEST( sharded_segment_tree, zero_shards_means_one )
+    {
+        check_concat(100, 0, 300);
+    }
+
+    TEST( sharded_segment_tree, empty_array )
+    {
+        sum_tree segtree(std::vector<int>(), 8, function_merge_policy<int, sum_node, set_default_value, merge>(), 4);
+        EXPECT_EQ(0u, segtree.get_array_size());
+        EXPECT_EQ(0u, segtree.shard_count());
+        segtree.point_update_batch(std::vector<std::pair<int, int>>());
+        EXPECT_GE(segtree.memory_footprint(), sizeof(segtree));
+    }
+
+
+    // Tests for updates and queries from many threads at once
+
+    TEST( sharded_segment_tree, readers_see_values_grow )
+    {
+        // Writers only raise values, and readers see each shard at a later
+        // moment than the previous query did, so sums never go down
+        size_t n = 5000;
+        sum_tree segtree(std::vector<int>(n, 0), 16);
+        std::atomic<bool> stop(false);
+        std::atomic<size_t> shrunk(0);
+        unsigned writers = 4;
+        std::vector<std::vector<int>> written(writers);
+
+        std::vector<std::thread> threads;
+        for (unsigned r = 0; r < 3; r++)
+        {
+            threads.push_back(std::thread([&, r]()
+            {
+                std::mt19937 gen(r);
+                std::uniform_int_distribution<> index_dis(0, n - 1);
+                int lo = index_dis(gen);
+                int hi = std::uniform_int_distribution<>(lo, n - 1)(gen);
+                long long last_whole = 0;
+                long long last_part = 0;
+                while (!stop.load())
+                {
+                    long long whole = segtree.range_query(0, (int)n - 1).sum;
+                    long long part = segtree.range_query(lo, hi).sum;
+                    if (whole < last_whole || part < last_part)
+                    {
+                        shrunk++;
+                    }
+                    last_whole = whole;
+                    last_part = part;
+                }
+            }));
+        }
+        for (unsigned w = 0; w < writers; w++)
+        {
+            // Writer w owns the indices equal to w modulo the writers
+            threads.push_back(std::thread([&, w]()
+            {
+                std::vector<int>& values = written[w];
+                values.assign(n, 0);
+                std::mt19937 gen(100 + w);
+                std::uniform_int_distribution<> index_dis(0, (int)(n / writers) - 1);
+                for (int i = 0; i < 20000; i++)
+                {
+                    int index = index_dis(gen) * writers + w;
+                    values[index] += 1 + i % 3;
+                    if (i % 10 == 0)
+                    {
+                        std::vector<std::pair<int, int>> updates(1, std::make_pair(index, values[index]));
+                        segtree.point_update_batch(updates);
+                    }
+                    else
+                    {
+                        segtree.point_update(index, values[index]);
+                    }
+                }
+            }));
+        }
+        for (size_t i = 3; i < threads.size(); i++)
+        {
+            threads[i].join();
+        }
+        stop.store(true);
+        for (size_t i = 0; i < 3; i++)
+        {
+            threads[i].join();
+        }
+        EXPECT_EQ(0u, shrunk.load());
+
+        long long prefix = 0;
+        for (size_t i = 0; i < n; i++)
+        {
+            prefix += written[i % writers][i];
+            EXPECT_EQ(written[i % writers][i], segtree.range_query(i, i).sum);
+        }
+        EXPECT_EQ(prefix, segtree.range_query(0, (int)n - 1).sum);
+    }
+
+
+    // Operations per second on a mixed workload, nine point updates to one
+    // query over a random interval, from 8 threads as the shard count grows.
+    // A single tree behind a mutex is the baseline. A benchmark that prints
+    // rather than checks, so it only runs with --gtest_also_run_disabled_tests.
+    template < typename F >
+    double operations_per_second( unsigned threads, size_t per_thread, F operation )
+    {
+        std::vector<std::thread> workers;
+        auto start = std::chrono::steady_clock::now();
+        for (unsigned t = 0; t < threads; t++)
+        {
+            workers.push_back(std::thread([&, t]()
+            {
+                std::mt19937 gen(t);
+                for (size_t i = 0; i < per_thread; i++)
+                {
+                    operation(gen, i);
+                }
+            }));
+        }
+        for (size_t i = 0; i < workers.size(); i++)
+        {
+            workers[i].join();
+        }
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        return threads * per_thread / elapsed.count();
+    }
+
+    TEST( sharded_segment_tree, DISABLED_throughput_by_shard_count )
+    {
+        size_t n = 1 << 18;
+        unsigned threads = 8;
+        size_t per_thread = 50000;
+        std::uniform_int_distribution<> index_dis(0, n - 1);
+
+        single_sum_tree single(std::vector<int>(n, 1));
+        std::mutex single_lock;
+        double baseline = operations_per_second(threads, per_thread,
+            [&]( std::mt19937& gen, size_t i )
+            {
+                int index = index_dis(gen);
+                std::lock_guard<std::mutex> lock(single_lock);
+                if (i % 10 == 0)
+                {
+                    single.range_query(index, std::min<int>(index + 1000, n - 1));
+                }
+                else
+                {
+                    single.point_update(index, (int)i);
+                }
+            });
+        std::cout << "mutex around one tree: " << (size_t)baseline << " operations/s" << std::endl;
+
+        for (size_t shards = 1; shards <= 64; shards *= 4)
+        {
+            sum_tree sharded(std::vector<int>(n, 1), shards);
+            double rate = operations_per_second(threads, per_thread,
+                [&]( std::mt19937& gen, size_t i )
+                {
+                    int index = index_dis(gen);
+                    if (i % 10 == 0)
+                    {
+                        sharded.range_query(index, std::min<int>(index + 1000, n - 1));
+                    }
+                    else
+                    {
+                        sharded.point_update(index, (int)i);
+                    }
+                });
+            std::cout << shards << " shards: " << (size_t)rate << " operations/s" << std::endl;
+        }
+    }
+}
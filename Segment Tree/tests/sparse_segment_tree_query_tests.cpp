@@ -0,0 +1,248 @@
+#include "pch.h"
+#include "sparse_segment_tree.hpp"
+
+#include <map>
+#include <vector>
+#include <random>
+#include <string>
+#include <cstdint>
+#include <utility>
+#include <algorithm>
+
+namespace sparse_segment_tree_query
+{
+    // Sums, and concatenations that show untouched gaps merged out of order
+    struct sum_node
+    {
+        long long sum;
+    };
+
+    void set_default_value( sum_node& x, int y )
+    {
+        x.sum = y;
+    }
+
+    sum_node merge( sum_node* a, sum_node* b )
+    {
+        sum_node result;
+        result.sum = a->sum + b->sum;
+        return result;
+    }
+
+    struct concat_node
+    {
+        std::string text;
+    };
+
+    void set_default_value( concat_node& x, char y )
+    {
+        x.text = std::string(1, y);
+    }
+
+    concat_node merge( concat_node* a, concat_node* b )
+    {
+        concat_node result;
+        result.text = a->text + b->text;
+        return result;
+    }
+}
+
+// Zero and the empty string are the identities of the merges
+template <>
+struct segment_tree_identity<sparse_segment_tree_query::sum_node>
+{
+    static sparse_segment_tree_query::sum_node value()
+    {
+        return sparse_segment_tree_query::sum_node{ 0 };
+    }
+};
+
+template <>
+struct segment_tree_identity<sparse_segment_tree_query::concat_node>
+{
+    static sparse_segment_tree_query::concat_node value()
+    {
+        return sparse_segment_tree_query::concat_node();
+    }
+};
+
+namespace sparse_segment_tree_query
+{
+    typedef sparse_segment_tree< int, sum_node, set_default_value, merge > sum_tree;
+    typedef sparse_segment_tree< char, concat_node, set_default_value, merge > concat_tree;
+
+    // Interleaves m updates at random positions of [0, n) with queries over
+    // random intervals, comparing against the updated positions kept in a map
+    void check_sum_queries( std::uint64_t n, size_t m )
+    {
+        sum_tree segtree(n);
+        EXPECT_EQ(n, segtree.get_array_size());
+
+        std::map<std::uint64_t, int> updated;
+        std::random_device rd;
+        std::mt19937_64 gen(rd());
+        std::uniform_int_distribution<std::uint64_t> index_dis(0, n - 1);
+        std::uniform_int_distribution<> value_dis(1, 1000);
+        for (int i = 0; i < (int)m; i++)
+        {
+            std::uint64_t index = index_dis(gen);
+            int value = value_dis(gen);
+            segtree.point_update(index, value);
+            updated[index] = value;
+
+            std::uint64_t lo = index_dis(gen);
+            std::uint64_t hi = std::uniform_int_distribution<std::uint64_t>(lo, n - 1)(gen);
+            long long expected = 0;
+            for (auto it = updated.lower_bound(lo); it != updated.end() && it->first <= hi; ++it)
+            {
+                expected += it->second;
+            }
+            EXPECT_EQ(expected, segtree.range_query(lo, hi).sum);
+        }
+
+        // Every update creates at most one node per level
+        size_t levels = 1;
+        for (std::uint64_t span = n; span > 1; span -= span / 2)
+        {
+            levels++;
+        }
+        EXPECT_GE(m * levels, segtree.node_count());
+    }
+
+
+    // Tests for range_query() and point_update()
+
+    TEST( sparse_segment_tree_sum, small_domain )
+    {
+        check_sum_queries(1, 10);
+        check_sum_queries(42, 420);
+    }
+
+    TEST( sparse_segment_tree_sum, huge_domain )
+    {
+        check_sum_queries((std::uint64_t)1 << 40, 2000);
+        check_sum_queries(((std::uint64_t)1 << 40) + 12345, 2000);
+        check_sum_queries(~(std::uint64_t)0, 2000);
+    }
+
+    TEST( sparse_segment_tree_concat, untouched_positions_are_empty )
+    {
+        std::uint64_t n = (std::uint64_t)1 << 40;
+        concat_tree segtree(n);
+        EXPECT_EQ("", segtree.range_query(0, n - 1).text);
+        EXPECT_EQ(0u, segtree.node_count());
+
+        segtree.point_update(n - 1, 'c');
+        segtree.point_update(0, 'a');
+        segtree.point_update(123456789012, 'b');
+        EXPECT_EQ("abc", segtree.range_query(0, n - 1).text);
+        EXPECT_EQ("ab", segtree.range_query(0, 123456789012).text);
+        EXPECT_EQ("bc", segtree.range_query(1, n - 1).text);
+        EXPECT_EQ("", segtree.range_query(1, 123456789011).text);
+
+        segtree.point_update(123456789012, 'x');
+        EXPECT_EQ("axc", segtree.range_query(0, n - 1).text);
+        EXPECT_GE(3u * 41, segtree.node_count());
+    }
+
+
+    // Tests for range_query_batch(), with trees below and past the size
+    // from which queries are interleaved
+
+    void check_batch_sum_queries( size_t positions, size_t m, unsigned threads )
+    {
+        std::uint64_t n = (std::uint64_t)1 << 40;
+        sum_tree segtree(n);
+        std::map<std::uint64_t, int> updated;
+        std::mt19937_64 gen(positions);
+        std::uniform_int_distribution<std::uint64_t> index_dis(0, n - 1);
+        for (size_t i = 0; i < positions; i++)
+        {
+            std::uint64_t index = index_dis(gen);
+            segtree.point_update(index, (int)(i % 1000));
+            updated[index] = (int)(i % 1000);
+        }
+
+        // Sums of the updated positions before each of them
+        std::vector<std::uint64_t> sorted;
+        std::vector<long long> prefix(1, 0);
+        for (auto it = updated.begin(); it != updated.end(); ++it)
+        {
+            sorted.push_back(it->first);
+            prefix.push_back(prefix.back() + it->second);
+        }
+
+        std::vector<std::pair<std::uint64_t, std::uint64_t>> queries;
+        for (size_t i = 0; i < m; i++)
+        {
+            std::uint64_t lo = index_dis(gen);
+            queries.push_back(std::make_pair(lo, std::uniform_int_distribution<std::uint64_t>(lo, n - 1)(gen)));
+        }
+        // Single positions, updated or not
+        queries.push_back(std::make_pair(sorted[0], sorted[0]));
+        queries.push_back(std::make_pair(sorted[0] + 1, sorted[0] + 1));
+        queries.push_back(std::make_pair((std::uint64_t)0, n - 1));
+
+        std::vector<sum_node> results;
+        segtree.range_query_batch(queries, results, threads);
+        ASSERT_EQ(queries.size(), results.size());
+        for (size_t i = 0; i < queries.size(); i++)
+        {
+            size_t from = std::lower_bound(sorted.begin(), sorted.end(), queries[i].first) - sorted.begin();
+            size_t to = std::upper_bound(sorted.begin(), sorted.end(), queries[i].second) - sorted.begin();
+            EXPECT_EQ(prefix[to] - prefix[from], results[i].sum);
+        }
+    }
+
+    TEST( sparse_segment_tree_batch_query, sum )
+    {
+        check_batch_sum_queries(1, 100, 1);
+        check_batch_sum_queries(1000, 10000, 1);
+        check_batch_sum_queries(1000, 10000, 4);
+    }
+
+    TEST( sparse_segment_tree_batch_query, sum_interleaved )
+    {
+        check_batch_sum_queries(300000, 100000, 1);
+        check_batch_sum_queries(300000, 100000, 3);
+    }
+
+    TEST( sparse_segment_tree_batch_query, concat_interleaved )
+    {
+        std::uint64_t n = (std::uint64_t)1 << 40;
+        concat_tree segtree(n);
+        std::vector<std::pair<std::uint64_t, std::uint64_t>> queries(1, std::make_pair((std::uint64_t)5, n - 1));
+        std::vector<concat_node> results;
+        segtree.range_query_batch(queries, results);
+        EXPECT_EQ("", results[0].text);
+
+        std::map<std::uint64_t, char> updated;
+        std::mt19937_64 gen(42);
+        std::uniform_int_distribution<std::uint64_t> index_dis(0, n - 1);
+        while (segtree.memory_footprint() < segment_tree_detail::interleave_bytes)
+        {
+            std::uint64_t index = index_dis(gen);
+            char value = (char)('a' + index % 26);
+            segtree.point_update(index, value);
+            updated[index] = value;
+        }
+
+        queries.clear();
+        for (size_t i = 0; i < 300; i++)
+        {
+            std::uint64_t lo = index_dis(gen);
+            queries.push_back(std::make_pair(lo, std::uniform_int_distribution<std::uint64_t>(lo, n - 1)(gen)));
+        }
+        segtree.range_query_batch(queries, results, 2);
+        ASSERT_EQ(queries.size(), results.size());
+        for (size_t i = 0; i < queries.size(); i++)
+        {
+            std::string expected;
+            for (auto it = updated.lower_bound(queries[i].first); it != updated.end() && it->first <= queries[i].second; ++it)
+            {
+                expected += it->second;
+            }
+            EXPECT_EQ(expected, results[i].text);
+        }
+    }
+}
@@ -0,0 +1,167 @@
+#include "pch.h"
+#include "sparse_table.hpp"
+
+#include <vector>
+#include <utility>
+#include <random>
+#include <string>
+#include <algorithm>
+
+namespace sparse_table_query
+{
+    // Structures and methods for testing the sparse tables with an
+    // idempotent merge, the minimum of an interval, and a non-commutative
+    // one, the concatenation of the characters in an interval
+    struct min_node
+    {
+        int min;
+    };
+
+    void set_default_value( min_node& x, int y )
+    {
+        x.min = y;
+    }
+
+    min_node merge( min_node* a, min_node* b )
+    {
+        if (a->min <= b->min)
+        {
+            return *a;
+        }
+        return *b;
+    }
+
+    struct concat_node
+    {
+        std::string text;
+    };
+
+    void set_default_value( concat_node& x, int y )
+    {
+        x.text = std::string(1, (char)('a' + y % 26));
+    }
+
+    concat_node merge( concat_node* a, concat_node* b )
+    {
+        concat_node result;
+        result.text = a->text + b->text;
+        return result;
+    }
+}
+
+// Taking the minimum twice changes nothing
+template <>
+struct segment_tree_idempotent<sparse_table_query::min_node> : std::true_type
+{
+};
+
+namespace sparse_table_query
+{
+    // Generates an array of n random integers ranging from 1 to n
+    void fill_with_random_integers( size_t n, std::vector<int>& parameter_array )
+    {
+        std::random_device rd;
+        std::mt19937 gen(rd());
+        std::uniform_int_distribution<> dis(1, n);
+        for (int i = 0; i < (int)n; i++)
+        {
+            parameter_array.push_back(dis(gen));
+        }
+    }
+
+    // Generates m random interval queries
+    void fill_with_random_intervals( size_t n, size_t m, std::vector<std::pair<int, int>>& queries )
+    {
+        std::random_device rd;
+        std::mt19937 gen(rd());
+        std::uniform_int_distribution<> dis1(0, n - 1);
+        for (int i = 0; i < (int)m; i++)
+        {
+            // Generate the lower bound of the interval
+            int x = dis1(gen);
+            // Make a uniform distribution within [x, n]
+            std::uniform_int_distribution<> dis2(x, n - 1);
+            // Generate the upper bound of the interval
+            int y = dis2(gen);
+            queries.push_back({x, y});
+        }
+    }
+
+    // Compares every query against the minimum found by brute force
+    template < typename table_type >
+    void check_min_queries( size_t n, size_t m )
+    {
+        std::vector<int> parameter_array;
+        fill_with_random_integers(n, parameter_array);
+
+        table_type table(parameter_array);
+
+        std::vector<std::pair<int, int>> queries;
+        fill_with_random_intervals(n, m, queries);
+
+        for (int i = 0; i < (int)m; i++)
+        {
+            int expected = *std::min_element(parameter_array.begin() + queries[i].first,
+                                             parameter_array.begin() + queries[i].second + 1);
+            EXPECT_EQ(expected, (table.range_query(queries[i].first, queries[i].second)).min);
+        }
+    }
+
+    // Compares every query against the concatenation found by brute force
+    void check_concat_queries( size_t n, size_t m )
+    {
+        std::vector<int> parameter_array;
+        fill_with_random_integers(n, parameter_array);
+
+        disjoint_sparse_table< int, concat_node, set_default_value, merge > table(parameter_array);
+
+        std::vector<std::pair<int, int>> queries;
+        fill_with_random_intervals(n, m, queries);
+
+        for (int i = 0; i < (int)m; i++)
+        {
+            std::string expected;
+            for (int j = queries[i].first; j <= queries[i].second; j++)
+            {
+                expected += (char)('a' + parameter_array[j] % 26);
+            }
+            EXPECT_EQ(expected, (table.range_query(queries[i].first, queries[i].second)).text);
+        }
+    }
+
+
+    // Tests for range_query() on the sparse table
+
+    TEST( sparse_table_min, vector_parameter_case1 )
+    {
+        check_min_queries< sparse_table< int, min_node, set_default_value, merge > >(1, 1);
+    }
+
+    TEST( sparse_table_min, vector_parameter_case2 )
+    {
+        check_min_queries< sparse_table< int, min_node, set_default_value, merge > >(42, 420);
+    }
+
+    TEST( sparse_table_min, vector_parameter_case3 )
+    {
+        check_min_queries< sparse_table< int, min_node, set_default_value, merge > >(4200, 4200);
+    }
+
+
+    // Tests for range_query() on the disjoint sparse table
+
+    TEST( disjoint_sparse_table_min, vector_parameter_case )
+    {
+        check_min_queries< disjoint_sparse_table< int, min_node, set_default_value, merge > >(1, 1);
+        check_min_queries< disjoint_sparse_table< int, min_node, set_default_value, merge > >(42, 420);
+        check_min_queries< disjoint_sparse_table< int, min_node, set_default_value, merge > >(4200, 4200);
+    }
+
+    TEST( disjoint_sparse_table_concat, vector_parameter_case )
+    {
+        check_concat_queries(1, 1);
+        check_concat_queries(2, 10);
+        check_concat_queries(42, 420);
+        check_concat_queries(1025, 420);
+    }
+}
@@ -1,9 +1,21 @@
 #include "pch.h"
 #include "segment_tree.hpp"
+#include "segment_tree_bucketed.hpp"
+#include "segment_tree_fenwick.hpp"
 
 #include <vector>
 #include <utility>
+#include <algorithm>
 #include <random>
+#include <string>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#if defined(_WIN32)
+#define NOMINMAX
+#include <windows.h>
+#endif
 
 namespace sum_int_query
 {
@@ -25,7 +37,34 @@ namespace sum_int_query
         ans.sum = a->sum + b->sum;
         return ans;
     }
-    
+}
+
+// Zero is the identity of the sum merge
+template <>
+struct segment_tree_identity<sum_int_query::node>
+{
+    static sum_int_query::node value()
+    {
+        sum_int_query::node identity;
+        identity.sum = 0;
+        return identity;
+    }
+};
+
+// Sums are undone by their negation
+template <>
+struct segment_tree_inverse<sum_int_query::node>
+{
+    static sum_int_query::node value( const sum_int_query::node& x )
+    {
+        sum_int_query::node inverse;
+        inverse.sum = -x.sum;
+        return inverse;
+    }
+};
+
+namespace sum_int_query
+{
     // Generates an array of n random integers ranging from 1 to n
     void fill_with_random_integers( size_t n, std::vector<int>& parameter_array )
     {
@@ -169,6 +208,310 @@ namespace sum_int_query
     }
 
 
+    // Tests for memory_footprint()
+
+    TEST( sum_int_segment_tree_footprint, no_bound_arrays )
+    {
+        size_t n = 42000;
+        std::vector<int> parameter_array;
+        fill_with_random_integers(n, parameter_array);
+
+        // What the node array plus the left and right bound arrays used to cost
+        size_t bounded_node_storage = (4 * n + 2) * (sizeof(node) + 2 * sizeof(int));
+
+        segment_tree< int, node, set_default_value, merge, segment_tree_backend::recursive > recursive_segtree(parameter_array);
+        EXPECT_GE(recursive_segtree.memory_footprint(), n * sizeof(int) + (4 * n + 2) * sizeof(node));
+        EXPECT_LT(recursive_segtree.memory_footprint(), n * sizeof(int) + bounded_node_storage);
+
+        segment_tree< int, node, set_default_value, merge, segment_tree_backend::iterative > iterative_segtree(parameter_array);
+        EXPECT_GE(iterative_segtree.memory_footprint(), n * sizeof(int) + 2 * n * sizeof(node));
+        EXPECT_LT(iterative_segtree.memory_footprint(), recursive_segtree.memory_footprint());
+    }
+
+    TEST( sum_int_segment_tree_footprint, compact_backend )
+    {
+        size_t n = 42001;
+        std::vector<int> parameter_array;
+        fill_with_random_integers(n, parameter_array);
+
+        // Exactly 2N - 1 nodes besides the array and the instance itself
+        segment_tree< int, node, set_default_value, merge, segment_tree_backend::compact > segtree(parameter_array);
+        EXPECT_GE(segtree.memory_footprint(), n * sizeof(int) + (2 * n - 1) * sizeof(node));
+        EXPECT_LT(segtree.memory_footprint(), n * sizeof(int) + (2 * n - 1) * sizeof(node) + 256);
+    }
+
+
+    // Tests for construction without copies of the array. Elements count
+    // their live instances, whose peak is the element storage held at once.
+
+    struct counted_int
+    {
+        static size_t live;
+        static size_t peak;
+        static size_t copies;
+
+        int value;
+
+        counted_int( int value = 0 )
+            : value(value)
+        {
+            born();
+        }
+
+        counted_int( const counted_int& x )
+            : value(x.value)
+        {
+            born();
+            copies++;
+        }
+
+        counted_int( counted_int&& x ) noexcept
+            : value(x.value)
+        {
+            born();
+        }
+
+        counted_int& operator=( const counted_int& x )
+        {
+            value = x.value;
+            copies++;
+            return *this;
+        }
+
+        counted_int& operator=( counted_int&& x ) noexcept
+        {
+            value = x.value;
+            return *this;
+        }
+
+        ~counted_int()
+        {
+            live--;
+        }
+
+        static void born()
+        {
+            live++;
+            peak = std::max(peak, live);
+        }
+
+        // Starts a measurement from the instances alive now
+        static void reset()
+        {
+            peak = live;
+            copies = 0;
+        }
+    };
+
+    size_t counted_int::live = 0;
+    size_t counted_int::peak = 0;
+    size_t counted_int::copies = 0;
+
+    struct counted_sum_policy
+    {
+        void set_default_value( node& x, const counted_int& y ) const
+        {
+            x.sum = y.value;
+        }
+
+        node merge( node* a, node* b ) const
+        {
+            node ans;
+            ans.sum = a->sum + b->sum;
+            return ans;
+        }
+    };
+
+    typedef basic_segment_tree< counted_int, node, counted_sum_policy > counted_segment_tree;
+    typedef basic_segment_tree< counted_int, node, counted_sum_policy, segment_tree_backend::iterative, int, false > counted_nodes_only_tree;
+
+    // Checks every prefix sum of segtree against the first n integers
+    template < typename tree_type >
+    void check_first_integers( tree_type& segtree, size_t n )
+    {
+        for (int i = 0; i < (int)n; i += 97)
+        {
+            EXPECT_EQ(i * (i + 1) / 2, segtree.range_query(0, i).sum);
+        }
+    }
+
+    TEST( sum_int_segment_tree_construction, copy_and_move )
+    {
+        size_t n = 4200;
+        std::vector<counted_int> parameter_array;
+        for (int i = 0; i < (int)n; i++)
+        {
+            parameter_array.push_back(counted_int(i));
+        }
+
+        // A const reference is copied, so the elements are held twice
+        counted_int::reset();
+        size_t before = counted_int::live;
+        {
+            counted_segment_tree segtree(parameter_array);
+            EXPECT_EQ(n, counted_int::copies);
+            EXPECT_EQ(before + n, counted_int::peak);
+            check_first_integers(segtree, n);
+        }
+
+        // An rvalue hands its storage over
+        counted_int::reset();
+        counted_segment_tree segtree(std::move(parameter_array));
+        EXPECT_EQ(0u, counted_int::copies);
+        EXPECT_EQ(before, counted_int::peak);
+        check_first_integers(segtree, n);
+
+        segtree.point_update(0, counted_int(5));
+        EXPECT_EQ(5, segtree.range_query(0, 0).sum);
+        EXPECT_EQ(5, segtree.get_array()[0].value);
+    }
+
+    TEST( sum_int_segment_tree_construction, iterators_and_generators )
+    {
+        size_t n = 4200;
+        std::vector<int> integers;
+        for (int i = 0; i < (int)n; i++)
+        {
+            integers.push_back(i);
+        }
+        size_t before = counted_int::live;
+
+        // Elements are made in place from the iterators
+        {
+            counted_int::reset();
+            counted_segment_tree segtree(integers.begin(), integers.end());
+            EXPECT_EQ(0u, counted_int::copies);
+            EXPECT_EQ(before + n, counted_int::peak);
+            check_first_integers(segtree, n);
+        }
+
+        // and from the generator, one temporary at a time
+        {
+            counted_int::reset();
+            counted_segment_tree segtree(n, []( size_t i ) { return counted_int((int)i); });
+            EXPECT_EQ(0u, counted_int::copies);
+            EXPECT_EQ(before + n + 1, counted_int::peak);
+            check_first_integers(segtree, n);
+        }
+    }
+
+    TEST( sum_int_segment_tree_construction, array_not_kept )
+    {
+        size_t n = 4200;
+        size_t before = counted_int::live;
+
+        // A generator never holds more than its current element
+        counted_int::reset();
+        counted_nodes_only_tree segtree(n, []( size_t i ) { return counted_int((int)i); });
+        EXPECT_EQ(before + 1, counted_int::peak);
+        EXPECT_EQ(before, counted_int::live);
+        check_first_integers(segtree, n);
+
+        // Random access iterators are read in place the same way
+        std::vector<int> integers;
+        for (int i = 0; i < (int)n; i++)
+        {
+            integers.push_back(i);
+        }
+        counted_int::reset();
+        counted_nodes_only_tree iterator_segtree(integers.begin(), integers.end());
+        EXPECT_EQ(before + 1, counted_int::peak);
+        EXPECT_EQ(before, counted_int::live);
+        check_first_integers(iterator_segtree, n);
+
+        // An rvalue is released once the nodes are built
+        std::vector<counted_int> parameter_array(n);
+        counted_int::reset();
+        counted_nodes_only_tree moved_segtree(std::move(parameter_array));
+        EXPECT_EQ(before + n, counted_int::peak);
+        EXPECT_EQ(before, counted_int::live);
+
+        // and the footprint has no room for elements
+        counted_segment_tree kept_segtree(n);
+        EXPECT_EQ(kept_segtree.memory_footprint(), moved_segtree.memory_footprint() + n * sizeof(counted_int));
+
+        std::vector<std::pair<int, counted_int>> updates;
+        updates.push_back({7, counted_int(1)});
+        updates.push_back({3, counted_int(2)});
+        updates.push_back({7, counted_int(4)});
+        moved_segtree.point_update_batch(updates);
+        moved_segtree.point_update(100, counted_int(8));
+        EXPECT_EQ(14, moved_segtree.range_query(0, n - 1).sum);
+        EXPECT_EQ(4, moved_segtree.range_query(4, 99).sum);
+    }
+
+
+    // Tests for merge policies
+
+    // Sum modulo a modulus only known at runtime
+    struct modular_sum_policy
+    {
+        int modulus;
+
+        void set_default_value( node& x, int y ) const
+        {
+            x.sum = y % modulus;
+        }
+
+        node merge( node* a, node* b ) const
+        {
+            node ans;
+            ans.sum = (a->sum + b->sum) % modulus;
+            return ans;
+        }
+    };
+
+    TEST( sum_int_segment_tree_policy, stateful_policy )
+    {
+        size_t n = 4200;
+        std::vector<int> parameter_array;
+        fill_with_random_integers(n, parameter_array);
+
+        modular_sum_policy policy;
+        policy.modulus = 1009;
+        basic_segment_tree< int, node, modular_sum_policy > segtree(parameter_array, policy);
+
+        size_t m = 420;
+        std::vector<std::pair<int, int>> queries;
+        fill_with_random_intervals(n, m, queries);
+
+        std::vector<int> brute_force_results(m);
+        run_brute_force(parameter_array, queries, brute_force_results);
+
+        for (int i = 0; i < (int)m; i++)
+        {
+            EXPECT_EQ(brute_force_results[i] % policy.modulus, (segtree.range_query(queries[i].first, queries[i].second)).sum);
+        }
+    }
+
+    TEST( sum_int_segment_tree_policy, capturing_lambdas )
+    {
+        size_t n = 4200;
+        std::vector<int> parameter_array;
+        fill_with_random_integers(n, parameter_array);
+
+        int modulus = 997;
+        auto segtree = make_segment_tree< int, node >(parameter_array,
+            [modulus]( node& x, int y ) { x.sum = y % modulus; },
+            [modulus]( node* a, node* b ) { node ans; ans.sum = (a->sum + b->sum) % modulus; return ans; });
+
+        size_t m = 420;
+        std::vector<std::pair<int, int>> queries;
+        fill_with_random_intervals(n, m, queries);
+
+        std::vector<int> brute_force_results(m);
+        run_brute_force(parameter_array, queries, brute_force_results);
+
+        for (int i = 0; i < (int)m; i++)
+        {
+            EXPECT_EQ(brute_force_results[i] % modulus, (segtree.range_query(queries[i].first, queries[i].second)).sum);
+        }
+
+        segtree.point_update(0, modulus + 5);
+        EXPECT_EQ(5, (segtree.range_query(0, 0)).sum);
+    }
+
+
     // Tests for range_query()
 
     TEST( sum_int_segment_tree_rquery, vector_parameter_case1 )
@@ -330,4 +673,436 @@ namespace sum_int_query
             }
         }
     }
+
+
+    // Tests for range_query_batch()
+
+    template < typename backend >
+    void check_batch_query( size_t n, size_t m, unsigned threads )
+    {
+        std::vector<int> parameter_array;
+        fill_with_random_integers(n, parameter_array);
+        segment_tree< int, node, set_default_value, merge, backend > segtree(parameter_array);
+
+        std::vector<std::pair<int, int>> queries;
+        fill_with_random_intervals(n, m, queries);
+        std::vector<int> brute_force_results(m);
+        run_brute_force(parameter_array, queries, brute_force_results);
+
+        // Stale contents of the results are overwritten
+        std::vector<node> results(3);
+        segtree.range_query_batch(queries, results, threads);
+        ASSERT_EQ(m, results.size());
+        for (int i = 0; i < (int)m; i++)
+        {
+            EXPECT_EQ(brute_force_results[i], results[i].sum);
+        }
+    }
+
+    TEST( sum_int_segment_tree_batch_query, iterative_backend )
+    {
+        check_batch_query<segment_tree_backend::iterative>(1, 3, 1);
+        check_batch_query<segment_tree_backend::iterative>(42, 0, 4);
+        check_batch_query<segment_tree_backend::iterative>(4200, 42000, 1);
+        check_batch_query<segment_tree_backend::iterative>(4200, 42000, 4);
+        check_batch_query<segment_tree_backend::iterative>(4200, 1000, 16);
+    }
+
+    TEST( sum_int_segment_tree_batch_query, other_backends )
+    {
+        check_batch_query<segment_tree_backend::recursive>(4200, 42000, 4);
+        check_batch_query<segment_tree_backend::compact>(4200, 42000, 4);
+        check_batch_query< segment_tree_backend::bucketed<16> >(4200, 42000, 4);
+        check_batch_query<segment_tree_backend::fenwick>(4200, 42000, 4);
+    }
+
+    TEST( sum_int_segment_tree_batch_query, matches_range_query )
+    {
+        size_t n = 42000;
+        size_t m = 42000;
+        std::vector<int> parameter_array;
+        fill_with_random_integers(n, parameter_array);
+        segment_tree< int, node, set_default_value, merge > segtree(parameter_array);
+        std::vector<std::pair<int, int>> queries;
+        fill_with_random_intervals(n, m, queries);
+
+        std::vector<node> results;
+        for (unsigned threads = 1; threads <= 8; threads++)
+        {
+            segtree.range_query_batch(queries, results, threads);
+            ASSERT_EQ(m, results.size());
+            for (size_t i = 0; i < m; i++)
+            {
+                EXPECT_EQ(segtree.range_query(queries[i].first, queries[i].second).sum, results[i].sum);
+            }
+        }
+    }
+
+    // Queries per second against a loop over range_query(). A benchmark that
+    // prints rather than checks, so it only runs with
+    // --gtest_also_run_disabled_tests.
+    TEST( sum_int_segment_tree_batch_query, DISABLED_throughput_by_thread_count )
+    {
+        size_t n = 1 << 20;
+        size_t m = 1 << 20;
+        std::vector<int> parameter_array;
+        fill_with_random_integers(n, parameter_array);
+        segment_tree< int, node, set_default_value, merge > segtree(parameter_array);
+        std::vector<std::pair<int, int>> queries;
+        fill_with_random_intervals(n, m, queries);
+        std::vector<node> results(m);
+
+        auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < m; i++)
+        {
+            results[i] = segtree.range_query(queries[i].first, queries[i].second);
+        }
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        std::cout << "loop: " << (size_t)(m / elapsed.count()) << " queries/s" << std::endl;
+        std::vector<node> expected = results;
+
+        for (unsigned threads = 1; threads <= 8; threads *= 2)
+        {
+            start = std::chrono::steady_clock::now();
+            segtree.range_query_batch(queries, results, threads);
+            elapsed = std::chrono::steady_clock::now() - start;
+            std::cout << threads << " threads: " << (size_t)(m / elapsed.count()) << " queries/s" << std::endl;
+            for (size_t i = 0; i < m; i += 997)
+            {
+                EXPECT_EQ(expected[i].sum, results[i].sum);
+            }
+        }
+    }
+
+
+    // Tests for point_update_batch()
+
+    template < typename backend, typename index_type = int, bool keep_array = true >
+    void check_batch_update( size_t n, size_t m, unsigned threads )
+    {
+        std::vector<int> parameter_array;
+        fill_with_random_integers(n, parameter_array);
+
+        segment_tree< int, node, set_default_value, merge, backend, index_type, keep_array > segtree(parameter_array);
+
+        // Random indices, repeated ones included
+        std::random_device rd;
+        std::mt19937 gen(rd());
+        std::uniform_int_distribution<> index_dis(0, n - 1);
+        std::uniform_int_distribution<> value_dis(1, n);
+        std::vector<std::pair<index_type, int>> updates;
+        for (int i = 0; i < (int)m; i++)
+        {
+            int index = index_dis(gen);
+            int value = value_dis(gen);
+            updates.push_back({index, value});
+            parameter_array[index] = value;
+        }
+        segtree.point_update_batch(updates, threads);
+
+        size_t q = 420;
+        std::vector<std::pair<int, int>> queries;
+        fill_with_random_intervals(n, q, queries);
+
+        std::vector<int> brute_force_results(q);
+        run_brute_force(parameter_array, queries, brute_force_results);
+
+        for (int i = 0; i < (int)q; i++)
+        {
+            EXPECT_EQ(brute_force_results[i], (segtree.range_query(queries[i].first, queries[i].second)).sum);
+        }
+    }
+
+    TEST( sum_int_segment_tree_batch_update, iterative_backend )
+    {
+        check_batch_update<segment_tree_backend::iterative>(1, 3, 1);
+        check_batch_update<segment_tree_backend::iterative>(42, 42, 1);
+        check_batch_update<segment_tree_backend::iterative>(42001, 42000, 1);
+        check_batch_update<segment_tree_backend::iterative>(42001, 42000, 4);
+    }
+
+    TEST( sum_int_segment_tree_batch_update, recursive_backend )
+    {
+        check_batch_update<segment_tree_backend::recursive>(1, 3, 1);
+        check_batch_update<segment_tree_backend::recursive>(42, 42, 1);
+        check_batch_update<segment_tree_backend::recursive>(42001, 42000, 1);
+        check_batch_update<segment_tree_backend::recursive>(42001, 42000, 4);
+    }
+
+    TEST( sum_int_segment_tree_batch_update, compact_backend )
+    {
+        check_batch_update<segment_tree_backend::compact>(1, 3, 1);
+        check_batch_update<segment_tree_backend::compact>(42, 42, 1);
+        check_batch_update<segment_tree_backend::compact>(42001, 42000, 1);
+        check_batch_update<segment_tree_backend::compact>(42001, 42000, 4);
+    }
+
+    TEST( sum_int_segment_tree_batch_update, bucketed_backend )
+    {
+        check_batch_update< segment_tree_backend::bucketed<16> >(1, 3, 1);
+        check_batch_update< segment_tree_backend::bucketed<16> >(42, 42, 1);
+        check_batch_update< segment_tree_backend::bucketed<16> >(42001, 42000, 1);
+        check_batch_update< segment_tree_backend::bucketed<16> >(42001, 42000, 4);
+    }
+
+    TEST( sum_int_segment_tree_batch_update, fenwick_backend )
+    {
+        check_batch_update<segment_tree_backend::fenwick>(1, 3, 1);
+        check_batch_update<segment_tree_backend::fenwick>(42, 42, 1);
+        check_batch_update<segment_tree_backend::fenwick>(42001, 420, 1);
+        check_batch_update<segment_tree_backend::fenwick>(42001, 42000, 1);
+    }
+
+    TEST( sum_int_segment_tree_batch_update, array_not_kept )
+    {
+        check_batch_update< segment_tree_backend::iterative, int, false >(1, 3, 1);
+        check_batch_update< segment_tree_backend::iterative, int, false >(42001, 42000, 1);
+        check_batch_update< segment_tree_backend::iterative, int, false >(42001, 42000, 4);
+        check_batch_update< segment_tree_backend::recursive, int, false >(42001, 42000, 4);
+        check_batch_update< segment_tree_backend::compact, int, false >(42001, 420, 1);
+        check_batch_update< segment_tree_backend::bucketed<16>, int, false >(42001, 42000, 4);
+        check_batch_update< segment_tree_backend::fenwick, int, false >(42001, 42000, 1);
+    }
+
+    TEST( sum_int_segment_tree_batch_update, wide_index_type )
+    {
+        check_batch_update< segment_tree_backend::iterative, std::uint64_t >(1, 3, 1);
+        check_batch_update< segment_tree_backend::iterative, std::uint64_t >(42001, 42000, 4);
+        check_batch_update< segment_tree_backend::recursive, std::uint64_t >(1, 3, 1);
+        check_batch_update< segment_tree_backend::recursive, std::uint64_t >(42001, 42000, 4);
+        check_batch_update< segment_tree_backend::recursive, std::int64_t >(42001, 42000, 1);
+        check_batch_update< segment_tree_backend::bucketed<16>, std::uint64_t >(42001, 42000, 1);
+        check_batch_update< segment_tree_backend::fenwick, std::uint64_t >(42001, 420, 1);
+    }
+
+
+    // Tests for the Fenwick backend, interleaving point updates and range queries
+
+    void check_fenwick_backend( size_t n, size_t m )
+    {
+        std::vector<int> parameter_array;
+        fill_with_random_integers(n, parameter_array);
+
+        segment_tree< int, node, set_default_value, merge, segment_tree_backend::fenwick > segtree(parameter_array);
+
+        std::vector<std::pair<int, int>> queries;
+        fill_with_random_intervals(n, m, queries);
+
+        std::random_device rd;
+        std::mt19937 gen(rd());
+        std::uniform_int_distribution<> value_dis(1, n);
+
+        std::vector<int> brute_force_results(1);
+        for (int i = 0; i < (int)m; i++)
+        {
+            int value = value_dis(gen);
+            segtree.point_update(queries[i].second, value);
+            parameter_array[queries[i].second] = value;
+
+            run_brute_force(parameter_array, std::vector<std::pair<int, int>>(1, queries[i]), brute_force_results);
+            EXPECT_EQ(brute_force_results[0], (segtree.range_query(queries[i].first, queries[i].second)).sum);
+        }
+    }
+
+    TEST( sum_int_segment_tree_fenwick, vector_parameter_case1 )
+    {
+        check_fenwick_backend(1, 10);
+    }
+
+    TEST( sum_int_segment_tree_fenwick, vector_parameter_case2 )
+    {
+        check_fenwick_backend(42, 420);
+    }
+
+    TEST( sum_int_segment_tree_fenwick, vector_parameter_case3 )
+    {
+        check_fenwick_backend(4200, 4200);
+    }
+
+    TEST( sum_int_segment_tree_fenwick, footprint )
+    {
+        size_t n = 42000;
+        std::vector<int> parameter_array;
+        fill_with_random_integers(n, parameter_array);
+
+        segment_tree< int, node, set_default_value, merge, segment_tree_backend::fenwick > segtree(parameter_array);
+        EXPECT_LT(segtree.memory_footprint(), n * sizeof(int) + (n + 2) * sizeof(node) + 256);
+    }
+
+
+    // Tests for the bucketed backend with a policy folding whole runs of leaves
+
+    struct sum_range_policy
+    {
+        void set_default_value( node& x, int y ) const
+        {
+            x.sum = y;
+        }
+
+        void merge( node& out, const node& a, const node& b ) const
+        {
+            out.sum = a.sum + b.sum;
+        }
+
+        void merge_range( node& out, const node* first, const node* last ) const
+        {
+            int sum = 0;
+            for (; first != last; first++)
+            {
+                sum += first->sum;
+            }
+            out.sum = sum;
+        }
+    };
+
+    template < size_t block_size >
+    void check_bucketed_backend( size_t n, size_t m )
+    {
+        std::vector<int> parameter_array;
+        fill_with_random_integers(n, parameter_array);
+
+        basic_segment_tree< int, node, sum_range_policy, segment_tree_backend::bucketed<block_size> > segtree(parameter_array);
+
+        std::vector<std::pair<int, int>> queries;
+        fill_with_random_intervals(n, m, queries);
+
+        std::random_device rd;
+        std::mt19937 gen(rd());
+        std::uniform_int_distribution<> value_dis(1, n);
+
+        std::vector<int> brute_force_results(1);
+        for (int i = 0; i < (int)m; i++)
+        {
+            int value = value_dis(gen);
+            segtree.point_update(queries[i].first, value);
+            parameter_array[queries[i].first] = value;
+
+            run_brute_force(parameter_array, std::vector<std::pair<int, int>>(1, queries[i]), brute_force_results);
+            EXPECT_EQ(brute_force_results[0], (segtree.range_query(queries[i].first, queries[i].second)).sum);
+        }
+    }
+
+    TEST( sum_int_segment_tree_bucketed, merge_range_policy )
+    {
+        check_bucketed_backend<64>(1, 10);
+        check_bucketed_backend<64>(42, 420);
+        check_bucketed_backend<64>(4200, 4200);
+        check_bucketed_backend<256>(4200, 4200);
+        check_bucketed_backend<3>(4200, 4200);
+    }
+
+    TEST( sum_int_segment_tree_bucketed, footprint )
+    {
+        size_t n = 42000;
+        std::vector<int> parameter_array;
+        fill_with_random_integers(n, parameter_array);
+
+        segment_tree< int, node, set_default_value, merge, segment_tree_backend::bucketed<64> > segtree(parameter_array);
+        EXPECT_LT(segtree.memory_footprint(), n * sizeof(int) + (n + 2 * (n / 64 + 1)) * sizeof(node) + 256);
+    }
+
+
+    // Tests for arrays past 2^31 elements with 64-bit positions. They need
+    // gigabytes of memory and are skipped when it is not available.
+
+    // One byte counters keep the footprint as small as possible, their sums
+    // wrap around modulo 256
+    struct byte_node
+    {
+        unsigned char sum;
+    };
+
+    void set_default_value( byte_node& x, unsigned char y )
+    {
+        x.sum = y;
+    }
+
+    byte_node merge( byte_node* a, byte_node* b )
+    {
+        byte_node ans;
+        ans.sum = (unsigned char)(a->sum + b->sum);
+        return ans;
+    }
+
+    // Physical memory available to the process in bytes, 0 if unknown
+    std::uint64_t available_memory()
+    {
+#if defined(_WIN32)
+        MEMORYSTATUSEX status;
+        status.dwLength = sizeof(status);
+        return GlobalMemoryStatusEx(&status) ? status.ullAvailPhys : 0;
+#else
+        std::ifstream meminfo("/proc/meminfo");
+        std::string key;
+        std::uint64_t kilobytes;
+        std::string unit;
+        while (meminfo >> key >> kilobytes >> unit)
+        {
+            if (key == "MemAvailable:")
+            {
+                return kilobytes * 1024;
+            }
+        }
+        return 0;
+#endif
+    }
+
+    // Updates positions on both sides of 2^31 of an array of 2^31 + 2^20
+    // counters and checks the queries crossing it. bytes_per_element is the
+    // footprint of the backend for each element, the array included.
+    template < typename backend >
+    void check_beyond_int_range( std::uint64_t bytes_per_element )
+    {
+        std::uint64_t n = ((std::uint64_t)1 << 31) + ((std::uint64_t)1 << 20);
+        std::uint64_t needed = n * bytes_per_element + n / 8;
+        if (sizeof(size_t) < 8 || available_memory() < needed)
+        {
+            std::cout << "Skipped, " << (needed >> 20) << " MB of free memory needed" << std::endl;
+            return;
+        }
+
+        segment_tree< unsigned char, byte_node, set_default_value, merge, backend, std::uint64_t > segtree(n);
+        EXPECT_EQ(n, segtree.get_array_size());
+
+        std::uint64_t boundary = (std::uint64_t)1 << 31;
+        std::vector<std::pair<std::uint64_t, unsigned char>> updates;
+        updates.push_back({0, 1});
+        updates.push_back({boundary - 1, 2});
+        updates.push_back({boundary, 4});
+        updates.push_back({boundary + 12345, 8});
+        updates.push_back({n - 1, 16});
+        for (size_t i = 0; i < updates.size(); i++)
+        {
+            segtree.point_update(updates[i].first, updates[i].second);
+        }
+
+        EXPECT_EQ(31, segtree.range_query(0, n - 1).sum);
+        EXPECT_EQ(6, segtree.range_query(boundary - 1, boundary).sum);
+        EXPECT_EQ(4, segtree.range_query(boundary, boundary).sum);
+        EXPECT_EQ(28, segtree.range_query(boundary, n - 1).sum);
+        EXPECT_EQ(3, segtree.range_query(0, boundary - 1).sum);
+        EXPECT_EQ(0, segtree.range_query(boundary + 1, boundary + 12344).sum);
+        EXPECT_EQ(24, segtree.range_query(boundary + 1, n - 1).sum);
+        EXPECT_EQ(16, segtree.range_query(n - 1, n - 1).sum);
+
+        // Batches take the same positions
+        updates.clear();
+        updates.push_back({boundary + 12345, 0});
+        updates.push_back({1, 32});
+        segtree.point_update_batch(updates);
+        EXPECT_EQ(55, segtree.range_query(0, n - 1).sum);
+        EXPECT_EQ(20, segtree.range_query(boundary, n - 1).sum);
+    }
+
+    TEST( sum_int_segment_tree_large, iterative_backend )
+    {
+        // The array and 2N nodes
+        check_beyond_int_range<segment_tree_backend::iterative>(3);
+    }
+
+    TEST( sum_int_segment_tree_large, bucketed_backend )
+    {
+        // The array and N leaves, the nodes above them are negligible
+        check_beyond_int_range< segment_tree_backend::bucketed<64> >(2);
+    }
 }
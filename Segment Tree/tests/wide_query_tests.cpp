@@ -0,0 +1,137 @@
+#include "pch.h"
+#include "wide_segment_tree.hpp"
+
+#include <vector>
+#include <utility>
+#include <random>
+
+namespace wide_query
+{
+    // Methods for testing the wide segment tree with sum, minimum
+    // and maximum reductions over integers and floats
+
+    // Generates an array of n random integers ranging from 1 to max_value
+    template < typename V >
+    void fill_with_random_values( size_t n, int max_value, std::vector<V>& parameter_array )
+    {
+        std::random_device rd;
+        std::mt19937 gen(rd());
+        std::uniform_int_distribution<> dis(1, max_value);
+        for (int i = 0; i < (int)n; i++)
+        {
+            parameter_array.push_back((V)dis(gen));
+        }
+    }
+
+    // Generates m random interval queries
+    void fill_with_random_intervals( size_t n, size_t m, std::vector<std::pair<int, int>>& queries )
+    {
+        std::random_device rd;
+        std::mt19937 gen(rd());
+        std::uniform_int_distribution<> dis1(0, n - 1);
+        for (int i = 0; i < (int)m; i++)
+        {
+            // Generate the lower bound of the interval
+            int x = dis1(gen);
+            // Make a uniform distribution within [x, n]
+            std::uniform_int_distribution<> dis2(x, n - 1);
+            // Generate the upper bound of the interval
+            int y = dis2(gen);
+            queries.push_back({x, y});
+        }
+    }
+
+    // Interleaves random point updates with range queries, checking every
+    // query against the brute force reduction. Values stay small enough for
+    // float sums to be exact.
+    template < typename V, typename reduction, size_t B >
+    void check_against_brute_force( size_t n, size_t m )
+    {
+        std::vector<V> parameter_array;
+        fill_with_random_values(n, 100, parameter_array);
+
+        wide_segment_tree< V, reduction, B > segtree(parameter_array);
+        EXPECT_EQ(n, segtree.get_array_size());
+
+        std::vector<std::pair<int, int>> queries;
+        fill_with_random_intervals(n, m, queries);
+
+        std::random_device rd;
+        std::mt19937 gen(rd());
+        std::uniform_int_distribution<> index_dis(0, n - 1);
+        std::uniform_int_distribution<> value_dis(1, 100);
+
+        for (int i = 0; i < (int)m; i++)
+        {
+            if (i % 2 == 0)
+            {
+                int index = index_dis(gen);
+                V value = (V)value_dis(gen);
+                segtree.point_update(index, value);
+                parameter_array[index] = value;
+            }
+
+            V expected = reduction::identity();
+            for (int j = queries[i].first; j <= queries[i].second; j++)
+            {
+                expected = reduction::combine(expected, parameter_array[j]);
+            }
+            EXPECT_EQ(expected, segtree.range_query(queries[i].first, queries[i].second));
+        }
+    }
+
+
+    // Tests for range_query() and point_update() with int values
+
+    TEST( wide_segment_tree_int, sum )
+    {
+        check_against_brute_force< int, wide_sum<int>, 16 >(1, 10);
+        check_against_brute_force< int, wide_sum<int>, 16 >(42, 420);
+        check_against_brute_force< int, wide_sum<int>, 16 >(4200, 4200);
+        check_against_brute_force< int, wide_sum<int>, 16 >(4096, 420);
+    }
+
+    TEST( wide_segment_tree_int, min )
+    {
+        check_against_brute_force< int, wide_min<int>, 16 >(1, 10);
+        check_against_brute_force< int, wide_min<int>, 16 >(42, 420);
+        check_against_brute_force< int, wide_min<int>, 16 >(4200, 4200);
+    }
+
+    TEST( wide_segment_tree_int, max )
+    {
+        check_against_brute_force< int, wide_max<int>, 16 >(1, 10);
+        check_against_brute_force< int, wide_max<int>, 16 >(42, 420);
+        check_against_brute_force< int, wide_max<int>, 16 >(4200, 4200);
+    }
+
+    TEST( wide_segment_tree_int, other_widths )
+    {
+        check_against_brute_force< int, wide_sum<int>, 2 >(4200, 420);
+        check_against_brute_force< int, wide_min<int>, 8 >(4200, 420);
+        check_against_brute_force< int, wide_max<int>, 32 >(4200, 420);
+        check_against_brute_force< int, wide_sum<int>, 5 >(4200, 420);
+    }
+
+
+    // Tests for range_query() and point_update() with float values
+
+    TEST( wide_segment_tree_float, sum )
+    {
+        check_against_brute_force< float, wide_sum<float>, 16 >(42, 420);
+        check_against_brute_force< float, wide_sum<float>, 16 >(4200, 4200);
+    }
+
+    TEST( wide_segment_tree_float, min_and_max )
+    {
+        check_against_brute_force< float, wide_min<float>, 16 >(4200, 4200);
+        check_against_brute_force< float, wide_max<float>, 16 >(4200, 4200);
+    }
+
+
+    // Test for a value type without vector instructions
+    TEST( wide_segment_tree_scalar, long_long_sum )
+    {
+        check_against_brute_force< long long, wide_sum<long long>, 16 >(4200, 4200);
+    }
+}